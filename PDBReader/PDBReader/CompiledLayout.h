@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <optional>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Layout of one structure resolved into plain offsets, for decoding raw memory without any name lookup.
+// Created by PDBReader::CompileLayout(), usable without DIA afterwards. Header only, so the accessors inline
+// into decoding loops.
+class CompiledLayout
+{
+public:
+    class Accessor
+    {
+    public:
+        uint32_t offset;
+        // bytes of the field, or of the storage unit for bitfields
+        uint32_t size;
+        uint32_t bit_position;
+        // 0 if the field is not a bitfield
+        uint32_t bit_length;
+        bool is_signed;
+    };
+
+    std::wstring name;
+    uint32_t size;
+    std::vector<std::wstring> field_names;
+    // same order as field_names, a field handle is an index into both
+    std::vector<Accessor> accessors;
+
+    // Resolve field handles once, outside of the decoding loop.
+    std::optional<uint32_t> FindField(const std::wstring& field) const
+    {
+        for (uint32_t i = 0; i < field_names.size(); i++)
+        {
+            if (field_names[i] == field)
+            {
+                return i;
+            }
+        }
+        return {};
+    }
+
+    // Value of a field of up to 8 bytes, sign extended for signed types. Bitfields are extracted.
+    // object must point to at least size bytes, nothing is checked.
+    uint64_t Read(const void* object, uint32_t field) const
+    {
+        auto& a = accessors[field];
+        uint64_t value = LoadLittleEndian((const uint8_t*)object + a.offset, a.size);
+        uint32_t bits = a.size * 8;
+        if (a.bit_length)
+        {
+            value >>= a.bit_position;
+            bits = a.bit_length;
+        }
+        if (bits < 64)
+        {
+            value &= (1ull << bits) - 1;
+            if (a.is_signed && (value >> (bits - 1)) & 1)
+            {
+                value |= ~0ull << bits;
+            }
+        }
+        return value;
+    }
+
+    // Bounds checked version of Read() for a buffer holding one object at its start.
+    // Returns nothing if the field is outside of the buffer or wider than 8 bytes.
+    std::optional<uint64_t> Read(const void* data, size_t data_size, uint32_t field) const
+    {
+        if (field >= accessors.size())
+        {
+            return {};
+        }
+        auto& a = accessors[field];
+        if (a.size > 8 || (uint64_t)a.offset + a.size > data_size)
+        {
+            return {};
+        }
+        return Read(data, field);
+    }
+
+    // Raw bytes of a field, for arrays and embedded structures. Points into object, nothing is copied.
+    const uint8_t* FieldBytes(const void* object, uint32_t field) const
+    {
+        return (const uint8_t*)object + accessors[field].offset;
+    }
+
+    // Decodes the given fields of count objects stored back to back (stride 0 means size) into one column per field,
+    // columns[k][i] is fields[k] of object i. Objects which don't fit into the buffer end the decoding.
+    // Returns the number of objects decoded.
+    size_t DecodeColumns(const void* data, size_t data_size, size_t count, const std::vector<uint32_t>& fields,
+        std::vector<std::vector<uint64_t>>& columns, size_t stride = 0) const
+    {
+        if (!stride)
+        {
+            stride = size;
+        }
+        // the furthest byte any requested field touches, every object has to provide that much
+        uint64_t needed = 0;
+        for (auto f : fields)
+        {
+            if (f >= accessors.size() || accessors[f].size > 8)
+            {
+                return 0;
+            }
+            needed = std::max<uint64_t>(needed, (uint64_t)accessors[f].offset + accessors[f].size);
+        }
+        if (stride && data_size >= needed)
+        {
+            count = (size_t)std::min<uint64_t>(count, (data_size - needed) / stride + 1);
+        }
+        else if (data_size < needed)
+        {
+            count = 0;
+        }
+        columns.resize(fields.size());
+        for (size_t k = 0; k < fields.size(); k++)
+        {
+            auto& column = columns[k];
+            column.resize(count);
+            auto base = (const uint8_t*)data;
+            for (size_t i = 0; i < count; i++)
+            {
+                column[i] = Read(base + i * stride, fields[k]);
+            }
+        }
+        return count;
+    }
+
+    // Unaligned little endian load, independent of the host byte order.
+    static uint64_t LoadLittleEndian(const uint8_t* p, uint32_t bytes)
+    {
+        uint64_t value = 0;
+        for (uint32_t i = 0; i < bytes && i < 8; i++)
+        {
+            value |= (uint64_t)p[i] << (i * 8);
+        }
+        return value;
+    }
+};
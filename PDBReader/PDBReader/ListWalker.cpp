@@ -0,0 +1,217 @@
+#include "ListWalker.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+    // state of the walk of one list
+    struct WalkState
+    {
+        uint64_t head;
+        bool started = false;
+        bool done = false;
+        // next link to visit from the front and from the back
+        uint64_t forward = 0;
+        uint64_t backward = 0;
+        bool backward_active = false;
+        std::vector<ListWalker::Node> front;
+        std::vector<ListWalker::Node> back;
+        // link address -> visited from the back
+        std::unordered_map<uint64_t, bool> visited;
+        ListWalker::Stop stop = ListWalker::Stop::End;
+
+        void Finish(ListWalker::Stop reason)
+        {
+            done = true;
+            stop = reason;
+        }
+    };
+
+    struct PendingRead
+    {
+        size_t list;
+        bool backward;
+    };
+}
+
+std::vector<ListWalker::Result> ListWalker::Walk(const std::vector<uint64_t>& heads, const ReadCallback& read, size_t limit) const
+{
+    // one read per element, covering the link and every field
+    uint32_t link_size = pointer_size * (doubly_linked ? 2 : 1);
+    uint32_t span_begin = link_offset;
+    uint32_t span_end = link_offset + link_size;
+    for (auto f : fields)
+    {
+        auto& a = layout.accessors[f];
+        span_begin = std::min(span_begin, a.offset);
+        span_end = std::max(span_end, a.offset + a.size);
+    }
+    uint32_t span_size = span_end - span_begin;
+    uint32_t link = link_offset - span_begin;
+
+    // the same fields, relative to the start of the span
+    CompiledLayout span_layout;
+    span_layout.size = span_size;
+    for (auto f : fields)
+    {
+        auto a = layout.accessors[f];
+        a.offset -= span_begin;
+        span_layout.accessors.push_back(a);
+    }
+
+    std::vector<WalkState> states(heads.size());
+    for (size_t i = 0; i < heads.size(); i++)
+    {
+        states[i].head = heads[i];
+    }
+
+    // at most two reads per list and round
+    std::vector<uint8_t> storage(heads.size() * 2 * (size_t)span_size);
+    std::vector<ReadRequest> requests;
+    std::vector<PendingRead> pending;
+    while (true)
+    {
+        requests.clear();
+        pending.clear();
+        auto request = [&](size_t list, bool backward, uint64_t address, uint32_t size)
+        {
+            requests.push_back({ address, size, storage.data() + requests.size() * span_size, false });
+            pending.push_back({ list, backward });
+        };
+
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            auto& state = states[i];
+            if (state.done)
+            {
+                continue;
+            }
+            if (!state.started)
+            {
+                request(i, false, state.head, link_size);
+                continue;
+            }
+
+            if (state.forward == state.head)
+            {
+                state.Finish(Stop::End);
+                continue;
+            }
+            auto seen = state.visited.find(state.forward);
+            if (seen != state.visited.end())
+            {
+                // reaching the part already walked from the back is the regular end
+                state.Finish(seen->second ? Stop::End : Stop::Cycle);
+                continue;
+            }
+            request(i, false, state.forward - link_offset + span_begin, span_size);
+
+            if (state.backward_active)
+            {
+                if (state.backward == state.head || state.backward == state.forward || state.visited.count(state.backward))
+                {
+                    // the front walk finishes the list alone
+                    state.backward_active = false;
+                }
+                else
+                {
+                    request(i, true, state.backward - link_offset + span_begin, span_size);
+                }
+            }
+        }
+        if (requests.empty())
+        {
+            break;
+        }
+
+        read(requests);
+
+        for (size_t k = 0; k < requests.size(); k++)
+        {
+            auto& req = requests[k];
+            auto& state = states[pending[k].list];
+            bool backward = pending[k].backward;
+
+            if (!state.started)
+            {
+                state.started = true;
+                if (!req.ok)
+                {
+                    state.Finish(Stop::ReadFailed);
+                    continue;
+                }
+                state.forward = CompiledLayout::LoadLittleEndian(req.buffer, pointer_size);
+                if (doubly_linked)
+                {
+                    state.backward = CompiledLayout::LoadLittleEndian(req.buffer + pointer_size, pointer_size);
+                    state.backward_active = state.backward != 0;
+                }
+                if (!state.forward)
+                {
+                    state.Finish(Stop::NullLink);
+                }
+                continue;
+            }
+            if (state.done)
+            {
+                // the front read of this round already ended the walk
+                continue;
+            }
+
+            if (!req.ok)
+            {
+                if (backward)
+                {
+                    state.backward_active = false;
+                }
+                else
+                {
+                    state.Finish(Stop::ReadFailed);
+                }
+                continue;
+            }
+
+            uint64_t address = backward ? state.backward : state.forward;
+            Node node;
+            node.address = address - link_offset;
+            node.values.resize(fields.size());
+            for (uint32_t f = 0; f < fields.size(); f++)
+            {
+                node.values[f] = span_layout.Read(req.buffer, f);
+            }
+            state.visited[address] = backward;
+            (backward ? state.back : state.front).push_back(std::move(node));
+
+            uint64_t next = CompiledLayout::LoadLittleEndian(req.buffer + link + (backward ? pointer_size : 0), pointer_size);
+            if (backward)
+            {
+                state.backward = next;
+                state.backward_active = next != 0;
+            }
+            else
+            {
+                state.forward = next;
+                if (!next)
+                {
+                    state.Finish(Stop::NullLink);
+                    continue;
+                }
+            }
+            if (state.front.size() + state.back.size() >= limit)
+            {
+                state.Finish(Stop::Limit);
+            }
+        }
+    }
+
+    std::vector<Result> results(states.size());
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        auto& state = states[i];
+        results[i].stop = state.stop;
+        results[i].nodes = std::move(state.front);
+        results[i].nodes.insert(results[i].nodes.end(),
+            std::make_move_iterator(state.back.rbegin()), std::make_move_iterator(state.back.rend()));
+    }
+    return results;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "CompiledLayout.h"
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+// Walks intrusive lists (LIST_ENTRY, SINGLE_LIST_ENTRY) in foreign memory, e.g. _EPROCESS.ActiveProcessLinks.
+// Created by PDBReader::CompileListWalker(), usable without DIA afterwards.
+// Every element is fetched with one read covering the link and all wanted fields, and the reads of all lists
+// being walked (and of both ends of doubly linked lists) are handed to the read callback together, so a walk
+// costs about length / 2 round trips instead of one round trip per field per element.
+class ListWalker
+{
+public:
+    class ReadRequest
+    {
+    public:
+        uint64_t address;
+        uint32_t size;
+        // size bytes, owned by the walker
+        uint8_t* buffer;
+        // set by the callback if buffer was filled
+        bool ok;
+    };
+
+    // Called once per round trip with every read of that round.
+    typedef std::function<void(std::vector<ReadRequest>& requests)> ReadCallback;
+
+    class Node
+    {
+    public:
+        // address of the containing structure, not of the link
+        uint64_t address;
+        // one value per field passed to CompileListWalker(), decoded like CompiledLayout::Read()
+        std::vector<uint64_t> values;
+    };
+
+    enum class Stop
+    {
+        // back at the head
+        End,
+        Limit,
+        // a link pointed to an element visited before from the same direction
+        Cycle,
+        ReadFailed,
+        NullLink,
+    };
+
+    class Result
+    {
+    public:
+        // in list order, starting after the head
+        std::vector<Node> nodes;
+        Stop stop;
+    };
+
+    CompiledLayout layout;
+    // offset of the list field in the structure
+    uint32_t link_offset;
+    // 4 or 8, the width of Flink/Blink in the target
+    uint32_t pointer_size;
+    // LIST_ENTRY has a Blink after the Flink, SINGLE_LIST_ENTRY doesn't
+    bool doubly_linked;
+    // field handles of layout, decoded into Node::values
+    std::vector<uint32_t> fields;
+
+    // Walks the lists whose heads (addresses of the head LIST_ENTRY) are given, all of them in the same round trips.
+    // Doubly linked lists are walked from both ends until the two walks meet. If a walk stops early (limit, cycle,
+    // read failure) the nodes found from both ends are still returned, so the middle of the list may be missing.
+    // limit caps the number of nodes per list.
+    std::vector<Result> Walk(const std::vector<uint64_t>& heads, const ReadCallback& read, size_t limit = 1000000) const;
+};
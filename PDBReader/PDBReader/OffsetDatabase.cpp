@@ -0,0 +1,482 @@
+#include "OffsetDatabase.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+// file layout, all integers little endian, section offsets are relative to the start of the file
+struct OffsetDatabase::DatabaseHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t build_count;
+    uint32_t build_buckets;
+    uint32_t query_count;
+    uint32_t query_buckets;
+    uint32_t layout_count;
+    uint32_t string_pool_size;
+    uint32_t reserved;
+    // uint32_t[build_buckets]
+    uint64_t build_displacements;
+    // BuildEntry[build_count], ordered by perfect hash slot
+    uint64_t builds;
+    // uint32_t[query_buckets]
+    uint64_t query_displacements;
+    // QueryEntry[query_count], ordered by perfect hash slot
+    uint64_t queries;
+    // uint32_t[layout_count][query_count], columns in query slot order
+    uint64_t layouts;
+    uint64_t string_pool;
+};
+
+namespace
+{
+    const char database_magic[8] = { 'P', 'D', 'B', 'O', 'F', 'F', 'D', 'B' };
+    constexpr uint32_t database_version = 1;
+
+    struct BuildEntry
+    {
+        uint8_t guid[16];
+        uint32_t age;
+        uint32_t layout;
+    };
+
+    struct QueryEntry
+    {
+        uint32_t key_offset;
+        uint32_t key_length;
+    };
+
+    uint64_t HashBytes(const void* data, size_t len)
+    {
+        auto p = (const uint8_t*)data;
+        uint64_t hash = 0xcbf29ce484222325;
+        for (size_t i = 0; i < len; i++)
+        {
+            hash ^= p[i];
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    // splitmix64 finalizer, rehashes a key hash with the displacement of its bucket
+    uint64_t Displace(uint64_t hash, uint32_t displacement)
+    {
+        uint64_t z = hash + (uint64_t)displacement * 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t BucketCount(size_t keys)
+    {
+        return (uint32_t)(keys / 2 + 1);
+    }
+
+    // displacements a bucket tries before the table is rebuilt with twice the buckets
+    constexpr uint32_t max_displacement = 1 << 20;
+    constexpr int max_perfect_hash_attempts = 8;
+
+    // hash and displace: keys are grouped into buckets by their hash, then every bucket, largest first,
+    // searches for a displacement which moves all its keys into free slots. slots[i] receives the slot of key i.
+    // Returns false if a bucket finds no displacement.
+    bool TryBuildPerfectHash(const std::vector<uint64_t>& hashes, uint32_t bucket_count, std::vector<uint32_t>& displacements, std::vector<uint32_t>& slots)
+    {
+        uint32_t n = (uint32_t)hashes.size();
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            buckets[hashes[i] % bucket_count].push_back(i);
+        }
+        std::vector<uint32_t> order(bucket_count);
+        for (uint32_t i = 0; i < bucket_count; i++)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+        displacements.assign(bucket_count, 0);
+        std::vector<bool> taken(n, false);
+        slots.assign(n, 0);
+        std::vector<uint32_t> candidate;
+        for (auto bucket : order)
+        {
+            auto& keys = buckets[bucket];
+            if (keys.empty())
+            {
+                break;
+            }
+            for (uint32_t displacement = 0; ; displacement++)
+            {
+                if (displacement == max_displacement)
+                {
+                    return false;
+                }
+                candidate.clear();
+                bool ok = true;
+                for (auto key : keys)
+                {
+                    uint32_t slot = (uint32_t)(Displace(hashes[key], displacement) % n);
+                    if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+                    {
+                        ok = false;
+                        break;
+                    }
+                    candidate.push_back(slot);
+                }
+                if (!ok)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < keys.size(); i++)
+                {
+                    taken[candidate[i]] = true;
+                    slots[keys[i]] = candidate[i];
+                }
+                displacements[bucket] = displacement;
+                break;
+            }
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> BuildPerfectHash(const std::vector<uint64_t>& hashes, std::vector<uint32_t>& slots)
+    {
+        // keys with equal hashes always collide, no displacement separates them
+        auto sorted = hashes;
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+        {
+            throw std::exception("cannot build perfect hash, duplicated keys");
+        }
+        // more buckets mean fewer keys per bucket, which makes displacements easier to find
+        uint32_t bucket_count = BucketCount(hashes.size());
+        std::vector<uint32_t> displacements;
+        for (int attempt = 0; attempt < max_perfect_hash_attempts; attempt++, bucket_count *= 2)
+        {
+            if (TryBuildPerfectHash(hashes, bucket_count, displacements, slots))
+            {
+                return displacements;
+            }
+        }
+        throw std::exception("cannot build perfect hash");
+    }
+
+    uint32_t LookupSlot(uint64_t hash, const uint32_t* displacements, uint32_t bucket_count, uint32_t n)
+    {
+        return (uint32_t)(Displace(hash, displacements[hash % bucket_count]) % n);
+    }
+
+    void BuildKey(const GUID& guid, DWORD age, uint8_t key[20])
+    {
+        memcpy(key, &guid, 16);
+        uint32_t a = age;
+        memcpy(key + 16, &a, 4);
+    }
+
+    // names are plain ascii, the kind goes first and the member is separated by a 0x01 byte
+    std::string QueryKey(const OffsetDatabase::Query& query)
+    {
+        std::string key;
+        key.push_back((char)('0' + (uint32_t)query.kind));
+        for (auto c : query.name)
+        {
+            key.push_back((char)c);
+        }
+        if (query.kind == OffsetDatabase::Query::Kind::StructMemberOffset)
+        {
+            key.push_back('\x01');
+            for (auto c : query.member)
+            {
+                key.push_back((char)c);
+            }
+        }
+        return key;
+    }
+
+    uint64_t Align8(uint64_t offset)
+    {
+        return (offset + 7) & ~7ull;
+    }
+}
+
+OffsetDatabase::OffsetDatabase(std::wstring db_file)
+{
+    file = CreateFileW(db_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::exception("Could not open offset database.");
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(DatabaseHeader))
+    {
+        CloseHandle(file);
+        throw std::exception("Offset database is truncated.");
+    }
+    file_size = size.QuadPart;
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        throw std::exception("Could not map offset database.");
+    }
+    base = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::exception("Could not map offset database.");
+    }
+    header = (const DatabaseHeader*)base;
+    auto section_fits = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= file_size && bytes <= file_size - offset;
+    };
+    bool valid = memcmp(header->magic, database_magic, sizeof(database_magic)) == 0
+        && header->version == database_version
+        && header->build_buckets >= BucketCount(header->build_count)
+        && header->query_buckets >= BucketCount(header->query_count)
+        && section_fits(header->build_displacements, (uint64_t)header->build_buckets * sizeof(uint32_t))
+        && section_fits(header->builds, (uint64_t)header->build_count * sizeof(BuildEntry))
+        && section_fits(header->query_displacements, (uint64_t)header->query_buckets * sizeof(uint32_t))
+        && section_fits(header->queries, (uint64_t)header->query_count * sizeof(QueryEntry))
+        && section_fits(header->layouts, (uint64_t)header->layout_count * header->query_count * sizeof(uint32_t))
+        && section_fits(header->string_pool, header->string_pool_size);
+    if (valid)
+    {
+        auto builds = (const BuildEntry*)(base + header->builds);
+        for (uint32_t i = 0; i < header->build_count && valid; i++)
+        {
+            valid = builds[i].layout < header->layout_count;
+        }
+        auto queries = (const QueryEntry*)(base + header->queries);
+        for (uint32_t i = 0; i < header->query_count && valid; i++)
+        {
+            valid = (uint64_t)queries[i].key_offset + queries[i].key_length <= header->string_pool_size;
+        }
+    }
+    if (!valid)
+    {
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::exception("Invalid offset database.");
+    }
+}
+
+OffsetDatabase::~OffsetDatabase()
+{
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+std::optional<uint32_t> OffsetDatabase::FindBuild(const GUID& guid, DWORD age) const
+{
+    if (!header->build_count)
+    {
+        return {};
+    }
+    uint8_t key[20];
+    BuildKey(guid, age, key);
+    auto displacements = (const uint32_t*)(base + header->build_displacements);
+    uint32_t slot = LookupSlot(HashBytes(key, sizeof(key)), displacements, header->build_buckets, header->build_count);
+    auto& entry = ((const BuildEntry*)(base + header->builds))[slot];
+    if (memcmp(entry.guid, key, 16) != 0 || entry.age != age)
+    {
+        return {};
+    }
+    return slot;
+}
+
+std::optional<uint32_t> OffsetDatabase::FindQuery(const Query& query) const
+{
+    if (!header->query_count)
+    {
+        return {};
+    }
+    auto key = QueryKey(query);
+    auto displacements = (const uint32_t*)(base + header->query_displacements);
+    uint32_t slot = LookupSlot(HashBytes(key.data(), key.size()), displacements, header->query_buckets, header->query_count);
+    auto& entry = ((const QueryEntry*)(base + header->queries))[slot];
+    if (entry.key_length != key.size() || memcmp(base + header->string_pool + entry.key_offset, key.data(), key.size()) != 0)
+    {
+        return {};
+    }
+    return slot;
+}
+
+std::optional<uint32_t> OffsetDatabase::Get(uint32_t build, uint32_t query) const
+{
+    if (build >= header->build_count || query >= header->query_count)
+    {
+        return {};
+    }
+    auto layout = ((const BuildEntry*)(base + header->builds))[build].layout;
+    auto value = ((const uint32_t*)(base + header->layouts))[(uint64_t)layout * header->query_count + query];
+    if (value == not_found)
+    {
+        return {};
+    }
+    return value;
+}
+
+uint32_t OffsetDatabase::BuildCount() const
+{
+    return header->build_count;
+}
+
+std::optional<uint32_t> OffsetDatabase::FindStructMemberOffset(const GUID& guid, DWORD age, const std::wstring& structName, const std::wstring& memberName) const
+{
+    auto build = FindBuild(guid, age);
+    auto query = FindQuery({ Query::Kind::StructMemberOffset, structName, memberName });
+    if (!build || !query)
+    {
+        return {};
+    }
+    return Get(*build, *query);
+}
+
+std::optional<uint32_t> OffsetDatabase::FindStructSize(const GUID& guid, DWORD age, const std::wstring& structName) const
+{
+    auto build = FindBuild(guid, age);
+    auto query = FindQuery({ Query::Kind::StructSize, structName, L"" });
+    if (!build || !query)
+    {
+        return {};
+    }
+    return Get(*build, *query);
+}
+
+std::optional<uint32_t> OffsetDatabase::FindSymbolRVA(const GUID& guid, DWORD age, const std::wstring& symbolName) const
+{
+    auto build = FindBuild(guid, age);
+    auto query = FindQuery({ Query::Kind::SymbolRVA, symbolName, L"" });
+    if (!build || !query)
+    {
+        return {};
+    }
+    return Get(*build, *query);
+}
+
+void OffsetDatabase::Write(const std::vector<Query>& queries, const std::vector<BuildLayout>& builds, const std::wstring& out_file)
+{
+    // queries, placed by their perfect hash slot. A query listed twice is stored once, with the values of its first occurrence
+    std::vector<std::string> keys;
+    std::vector<uint64_t> query_hashes;
+    std::map<std::string, uint32_t> key_index;
+    // index into keys of every query
+    std::vector<uint32_t> query_keys;
+    for (auto& query : queries)
+    {
+        auto key = QueryKey(query);
+        auto itr = key_index.find(key);
+        if (itr == key_index.end())
+        {
+            itr = key_index.emplace(key, (uint32_t)keys.size()).first;
+            query_hashes.push_back(HashBytes(key.data(), key.size()));
+            keys.push_back(std::move(key));
+        }
+        query_keys.push_back(itr->second);
+    }
+    std::vector<uint32_t> query_slots;
+    auto query_displacements = BuildPerfectHash(query_hashes, query_slots);
+    std::string string_pool;
+    std::vector<QueryEntry> query_entries(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        query_entries[query_slots[i]] = { (uint32_t)string_pool.size(), (uint32_t)keys[i].size() };
+        string_pool += keys[i];
+    }
+
+    // identical layouts are stored once, builds only keep the layout index
+    std::map<std::vector<uint32_t>, uint32_t> layout_index;
+    std::vector<std::vector<uint32_t>> layouts;
+    std::vector<BuildEntry> unique_builds;
+    std::vector<uint64_t> build_hashes;
+    std::map<std::vector<uint8_t>, bool> seen_builds;
+    for (auto& build : builds)
+    {
+        if (build.values.size() != queries.size())
+        {
+            throw std::exception("build layout doesn't match the query list");
+        }
+        BuildEntry entry = {};
+        uint8_t key[20];
+        BuildKey(build.guid, build.age, key);
+        if (seen_builds[std::vector<uint8_t>(key, key + sizeof(key))])
+        {
+            continue;
+        }
+        seen_builds[std::vector<uint8_t>(key, key + sizeof(key))] = true;
+        std::vector<uint32_t> values(keys.size());
+        for (size_t i = queries.size(); i-- > 0; )
+        {
+            // backwards, so the first occurrence of a duplicated query wins
+            values[query_slots[query_keys[i]]] = build.values[i];
+        }
+        auto itr = layout_index.find(values);
+        if (itr == layout_index.end())
+        {
+            itr = layout_index.emplace(values, (uint32_t)layouts.size()).first;
+            layouts.push_back(values);
+        }
+        memcpy(entry.guid, key, 16);
+        entry.age = build.age;
+        entry.layout = itr->second;
+        unique_builds.push_back(entry);
+        build_hashes.push_back(HashBytes(key, sizeof(key)));
+    }
+    std::vector<uint32_t> build_slots;
+    auto build_displacements = BuildPerfectHash(build_hashes, build_slots);
+    std::vector<BuildEntry> build_entries(unique_builds.size());
+    for (size_t i = 0; i < unique_builds.size(); i++)
+    {
+        build_entries[build_slots[i]] = unique_builds[i];
+    }
+
+    DatabaseHeader header = {};
+    memcpy(header.magic, database_magic, sizeof(database_magic));
+    header.version = database_version;
+    header.build_count = (uint32_t)build_entries.size();
+    header.build_buckets = (uint32_t)build_displacements.size();
+    header.query_count = (uint32_t)query_entries.size();
+    header.query_buckets = (uint32_t)query_displacements.size();
+    header.layout_count = (uint32_t)layouts.size();
+    header.string_pool_size = (uint32_t)string_pool.size();
+    header.build_displacements = Align8(sizeof(header));
+    header.builds = Align8(header.build_displacements + build_displacements.size() * sizeof(uint32_t));
+    header.query_displacements = Align8(header.builds + build_entries.size() * sizeof(BuildEntry));
+    header.queries = Align8(header.query_displacements + query_displacements.size() * sizeof(uint32_t));
+    header.layouts = Align8(header.queries + query_entries.size() * sizeof(QueryEntry));
+    header.string_pool = Align8(header.layouts + (uint64_t)layouts.size() * keys.size() * sizeof(uint32_t));
+
+    std::ofstream out;
+    out.open(out_file, std::ofstream::binary);
+    if (!out.is_open())
+    {
+        throw std::exception("cannot create file for output");
+    }
+    auto pad_to = [&](uint64_t offset) {
+        static const char zeros[8] = {};
+        out.write(zeros, offset - (uint64_t)out.tellp());
+    };
+    out.write((const char*)&header, sizeof(header));
+    pad_to(header.build_displacements);
+    out.write((const char*)build_displacements.data(), build_displacements.size() * sizeof(uint32_t));
+    pad_to(header.builds);
+    out.write((const char*)build_entries.data(), build_entries.size() * sizeof(BuildEntry));
+    pad_to(header.query_displacements);
+    out.write((const char*)query_displacements.data(), query_displacements.size() * sizeof(uint32_t));
+    pad_to(header.queries);
+    out.write((const char*)query_entries.data(), query_entries.size() * sizeof(QueryEntry));
+    pad_to(header.layouts);
+    for (auto& layout : layouts)
+    {
+        out.write((const char*)layout.data(), layout.size() * sizeof(uint32_t));
+    }
+    pad_to(header.string_pool);
+    out.write(string_pool.data(), string_pool.size());
+    if (!out.good())
+    {
+        throw std::exception("failed to write offset database");
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <optional>
+#include <cstdint>
+#include <vector>
+
+// Offsets, sizes and symbol rvas of many builds compiled into one file, looked up by the pdb's (guid, age)
+// without any pdb or DIA present. Only depends on windows.h, so it can be used without pdbreader.cpp.
+// Files are written by PDBReader::BuildOffsetDatabase().
+class OffsetDatabase
+{
+public:
+    class Query
+    {
+    public:
+        enum class Kind : uint32_t
+        {
+            StructMemberOffset,
+            StructSize,
+            SymbolRVA,
+        };
+        Kind kind;
+        // structure name, or symbol name for SymbolRVA
+        std::wstring name;
+        // only used by StructMemberOffset
+        std::wstring member;
+    };
+
+    class BuildLayout
+    {
+    public:
+        GUID guid;
+        DWORD age;
+        // one value per query, not_found if the query failed for this build
+        std::vector<uint32_t> values;
+    };
+
+    static constexpr uint32_t not_found = 0xffffffff;
+
+    // Maps db_file read only, throws if it isn't a valid database.
+    OffsetDatabase(std::wstring db_file);
+
+    ~OffsetDatabase();
+
+    OffsetDatabase(const OffsetDatabase&) = delete;
+    OffsetDatabase& operator=(const OffsetDatabase&) = delete;
+
+    std::optional<uint32_t> FindStructMemberOffset(const GUID& guid, DWORD age, const std::wstring& structName, const std::wstring& memberName) const;
+
+    std::optional<uint32_t> FindStructSize(const GUID& guid, DWORD age, const std::wstring& structName) const;
+
+    std::optional<uint32_t> FindSymbolRVA(const GUID& guid, DWORD age, const std::wstring& symbolName) const;
+
+    // Handles for hot loops: resolve the build and the queries once, then every Get() is two array reads.
+    std::optional<uint32_t> FindBuild(const GUID& guid, DWORD age) const;
+
+    std::optional<uint32_t> FindQuery(const Query& query) const;
+
+    std::optional<uint32_t> Get(uint32_t build, uint32_t query) const;
+
+    uint32_t BuildCount() const;
+
+    // Writes the database, identical layouts are stored once. Builds with the same (guid, age) are kept once as well.
+    static void Write(const std::vector<Query>& queries, const std::vector<BuildLayout>& builds, const std::wstring& out_file);
+
+private:
+    struct DatabaseHeader;
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const uint8_t* base = nullptr;
+    uint64_t file_size = 0;
+
+    const DatabaseHeader* header = nullptr;
+};
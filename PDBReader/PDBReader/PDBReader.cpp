@@ -3,6 +3,299 @@
 #include <fstream>
 #include <string>
 #include <codecvt>
+#include <algorithm>
+#include <memory>
+#include <regex>
+#include <cwctype>
+#include <cstring>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+#ifdef PDBREADER_ENABLE_STATS
+#include <chrono>
+
+namespace
+{
+    enum StatsApi
+    {
+        ApiFindSymbol,
+        ApiFindStructMemberOffset,
+        ApiFindStructSize,
+        ApiFindMostRelatedFunctionName,
+        ApiFindNearestSymbolFromRVA,
+        ApiDumpTypes,
+        ApiGetStructureFields,
+        ApiGetTypeInfo,
+        ApiSearchSymbols,
+        ApiFindSymbolsAnySpelling,
+        ApiDiffStructures,
+        ApiResolveOffsets,
+        ApiGetEnum,
+        ApiGetFunctionSignature,
+        ApiGetVirtualTable,
+        ApiGetFlattenedLayout,
+        ApiAnalyzeLayout,
+        ApiFindLocalsFromRVA,
+        ApiCount,
+    };
+    const char* api_names[ApiCount] = { "FindSymbol", "FindStructMemberOffset", "FindStructSize", "FindMostRelatedFunctionName",
+        "FindNearestSymbolFromRVA", "DumpTypes", "GetStructureFields", "GetTypeInfo", "SearchSymbols",
+        "FindSymbolsAnySpelling", "DiffStructures", "ResolveOffsets", "GetEnum", "GetFunctionSignature",
+        "GetVirtualTable", "GetFlattenedLayout", "AnalyzeLayout", "FindLocalsFromRVA" };
+
+    enum StatsCache
+    {
+        CacheSymbolRVA,
+        CacheSymbolTypeInfo,
+        CacheStructureFieldInfo,
+        CacheSymbolMiss,
+        CacheSymbolNameFilter,
+        CacheUndecoratedName,
+        CacheTypeHash,
+        CacheEnum,
+        CacheFunctionSignature,
+        CacheVirtualSlot,
+        CacheFlattenedLayout,
+        CacheTypeAlignment,
+        CacheCount,
+    };
+    const char* cache_names[CacheCount] = { "symbolRVACache", "symbolTypeInfoCache", "structureFieldInfoCache", "symbolMissCache", "symbolNameFilter",
+        "undecoratedNameCache", "typeHashCache", "enumCache",
+        "functionSignatureCache", "virtualSlotCache", "flattenedLayoutCache", "typeAlignmentCache" };
+
+    enum StatsCacheEvent
+    {
+        CacheHit,
+        CacheMiss,
+        CacheInsert,
+        CacheEventCount,
+    };
+    const char* cache_event_names[CacheEventCount] = { "hit", "miss", "insert" };
+
+    enum StatsIndex
+    {
+        IndexSortedFunctionRVANameList,
+        IndexSymbolNameFilter,
+        IndexSortedSymbolNameIndex,
+        IndexAlternateNameIndexes,
+        IndexGlobalVariableTable,
+        IndexCount,
+    };
+    const char* index_names[IndexCount] = { "SortedFunctionRVANameList", "SymbolNameFilter", "SortedSymbolNameIndex", "AlternateNameIndexes",
+        "GlobalVariableTable" };
+
+    // log-linear latency buckets in the spirit of HdrHistogram: values below 8ns are exact,
+    // above that every power of two is split into 8 sub buckets (~12% relative error)
+    constexpr int latency_sub_bucket_bits = 3;
+    constexpr int latency_sub_buckets = 1 << latency_sub_bucket_bits;
+    constexpr int latency_bucket_count = (64 - latency_sub_bucket_bits + 1) << latency_sub_bucket_bits;
+
+    int LatencyBucket(uint64_t ns)
+    {
+        if (ns < latency_sub_buckets)
+        {
+            return (int)ns;
+        }
+        int msb = 0;
+        for (int step = 32; step; step >>= 1)
+        {
+            if (ns >> (msb + step))
+            {
+                msb += step;
+            }
+        }
+        int shift = msb - latency_sub_bucket_bits;
+        return ((shift + 1) << latency_sub_bucket_bits) + (int)((ns >> shift) & (latency_sub_buckets - 1));
+    }
+
+    uint64_t LatencyBucketUpperBound(int bucket)
+    {
+        if (bucket < latency_sub_buckets)
+        {
+            return bucket;
+        }
+        int shift = (bucket >> latency_sub_bucket_bits) - 1;
+        uint64_t sub = (uint64_t)latency_sub_buckets + (bucket & (latency_sub_buckets - 1));
+        return ((sub + 1) << shift) - 1;
+    }
+
+    // every thread owns one block and is the only writer of it, so counters are bumped with plain
+    // relaxed load/store instead of locked read-modify-write. snapshots sum all blocks on demand.
+    struct ThreadStats
+    {
+        std::atomic<uint64_t> api_calls[ApiCount]{};
+        std::atomic<uint64_t> api_total_ns[ApiCount]{};
+        std::atomic<uint64_t> api_latency[ApiCount][latency_bucket_count]{};
+        std::atomic<uint64_t> cache_events[CacheCount][CacheEventCount]{};
+        std::atomic<uint64_t> index_builds[IndexCount]{};
+        std::atomic<uint64_t> index_build_ns[IndexCount]{};
+        std::atomic<uint64_t> bytes_mapped{};
+    };
+
+    struct StatsSnapshot
+    {
+        uint64_t api_calls[ApiCount] = {};
+        uint64_t api_total_ns[ApiCount] = {};
+        uint64_t api_latency[ApiCount][latency_bucket_count] = {};
+        uint64_t cache_events[CacheCount][CacheEventCount] = {};
+        uint64_t index_builds[IndexCount] = {};
+        uint64_t index_build_ns[IndexCount] = {};
+        uint64_t bytes_mapped = 0;
+    };
+
+    void Bump(std::atomic<uint64_t>& counter, uint64_t value = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void Accumulate(StatsSnapshot& out, const ThreadStats& in)
+    {
+        for (int i = 0; i < ApiCount; i++)
+        {
+            out.api_calls[i] += in.api_calls[i].load(std::memory_order_relaxed);
+            out.api_total_ns[i] += in.api_total_ns[i].load(std::memory_order_relaxed);
+            for (int b = 0; b < latency_bucket_count; b++)
+            {
+                out.api_latency[i][b] += in.api_latency[i][b].load(std::memory_order_relaxed);
+            }
+        }
+        for (int i = 0; i < CacheCount; i++)
+        {
+            for (int e = 0; e < CacheEventCount; e++)
+            {
+                out.cache_events[i][e] += in.cache_events[i][e].load(std::memory_order_relaxed);
+            }
+        }
+        for (int i = 0; i < IndexCount; i++)
+        {
+            out.index_builds[i] += in.index_builds[i].load(std::memory_order_relaxed);
+            out.index_build_ns[i] += in.index_build_ns[i].load(std::memory_order_relaxed);
+        }
+        out.bytes_mapped += in.bytes_mapped.load(std::memory_order_relaxed);
+    }
+
+    struct StatsRegistry
+    {
+        std::mutex lock;
+        std::vector<ThreadStats*> live;
+        // counters of threads which have already exited
+        StatsSnapshot retired;
+    };
+
+    StatsRegistry& Registry()
+    {
+        static StatsRegistry registry;
+        return registry;
+    }
+
+    struct ThreadStatsHolder
+    {
+        ThreadStats stats;
+
+        ThreadStatsHolder()
+        {
+            auto& registry = Registry();
+            std::lock_guard<std::mutex> lock(registry.lock);
+            registry.live.push_back(&stats);
+        }
+
+        ~ThreadStatsHolder()
+        {
+            auto& registry = Registry();
+            std::lock_guard<std::mutex> lock(registry.lock);
+            Accumulate(registry.retired, stats);
+            registry.live.erase(std::find(registry.live.begin(), registry.live.end(), &stats));
+        }
+    };
+
+    ThreadStats& LocalStats()
+    {
+        thread_local ThreadStatsHolder holder;
+        return holder.stats;
+    }
+
+    std::unique_ptr<StatsSnapshot> TakeSnapshot()
+    {
+        auto snapshot = std::make_unique<StatsSnapshot>();
+        auto& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        *snapshot = registry.retired;
+        for (auto stats : registry.live)
+        {
+            Accumulate(*snapshot, *stats);
+        }
+        return snapshot;
+    }
+
+    class ApiTimer
+    {
+    public:
+        ApiTimer(StatsApi api) : api(api), start(std::chrono::steady_clock::now()) {}
+
+        ~ApiTimer()
+        {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            auto& stats = LocalStats();
+            Bump(stats.api_calls[api]);
+            Bump(stats.api_total_ns[api], ns);
+            Bump(stats.api_latency[api][LatencyBucket(ns)]);
+        }
+
+    private:
+        StatsApi api;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    class IndexBuildTimer
+    {
+    public:
+        IndexBuildTimer(StatsIndex index) : index(index), start(std::chrono::steady_clock::now()) {}
+
+        ~IndexBuildTimer()
+        {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            auto& stats = LocalStats();
+            Bump(stats.index_builds[index]);
+            Bump(stats.index_build_ns[index], ns);
+        }
+
+    private:
+        StatsIndex index;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    uint64_t LatencyPercentile(const uint64_t* buckets, uint64_t total, double percentile)
+    {
+        if (!total)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(total * percentile);
+        uint64_t seen = 0;
+        for (int b = 0; b < latency_bucket_count; b++)
+        {
+            seen += buckets[b];
+            if (seen > rank)
+            {
+                return LatencyBucketUpperBound(b);
+            }
+        }
+        return LatencyBucketUpperBound(latency_bucket_count - 1);
+    }
+}
+
+#define PDBREADER_STATS_API(api) ApiTimer pdbreader_api_timer(Api##api)
+#define PDBREADER_STATS_CACHE(cache, event) Bump(LocalStats().cache_events[Cache##cache][Cache##event])
+#define PDBREADER_STATS_INDEX_BUILD(index) IndexBuildTimer pdbreader_index_build_timer(Index##index)
+#define PDBREADER_STATS_BYTES_MAPPED(bytes) Bump(LocalStats().bytes_mapped, bytes)
+#else
+#define PDBREADER_STATS_API(api) ((void)0)
+#define PDBREADER_STATS_CACHE(cache, event) ((void)0)
+#define PDBREADER_STATS_INDEX_BUILD(index) ((void)0)
+#define PDBREADER_STATS_BYTES_MAPPED(bytes) ((void)0)
+#endif
 
 std::string wstring2stringbytruncation(const std::wstring& in)
 {
@@ -10,6 +303,167 @@ std::string wstring2stringbytruncation(const std::wstring& in)
     return str;
 }
 
+// names read from the pdb file directly are utf-8
+static std::wstring Utf8ToWstring(const char* in)
+{
+    int length = MultiByteToWideChar(CP_UTF8, 0, in, -1, nullptr, 0);
+    if (length <= 1)
+    {
+        return {};
+    }
+    std::wstring ret(length - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, in, -1, &ret[0], length);
+    return ret;
+}
+
+// 64 bit FNV-1a, used by the bloom filter over symbol names
+static uint64_t HashSymbolName(const wchar_t* name, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint16_t)name[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// '*' matches any sequence, '?' matches one character
+static bool WildcardMatch(const wchar_t* name, const wchar_t* pattern)
+{
+    const wchar_t* star = nullptr;
+    const wchar_t* resume = nullptr;
+    while (*name)
+    {
+        if (*pattern == L'?' || (*pattern && *pattern != L'*' && *pattern == *name))
+        {
+            name++;
+            pattern++;
+        }
+        else if (*pattern == L'*')
+        {
+            star = pattern++;
+            resume = name;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            name = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == L'*')
+    {
+        pattern++;
+    }
+    return !*pattern;
+}
+
+// literal characters every match of pattern has to start with
+static std::wstring LiteralPrefix(const std::wstring& pattern, PDBReader::SearchMode mode)
+{
+    if (mode == PDBReader::SearchMode::Prefix)
+    {
+        return pattern;
+    }
+    if (mode == PDBReader::SearchMode::Wildcard)
+    {
+        return pattern.substr(0, pattern.find_first_of(L"*?"));
+    }
+    // regex: only a '^' anchored run of plain characters, minus a last one made optional by a quantifier
+    if (pattern.empty() || pattern[0] != L'^' || pattern.find(L'|') != std::wstring::npos)
+    {
+        return L"";
+    }
+    static const std::wstring meta = L".[]{}()*+?|\\^$";
+    size_t end = pattern.find_first_of(meta, 1);
+    std::wstring prefix = pattern.substr(1, end == std::wstring::npos ? std::wstring::npos : end - 1);
+    if (end != std::wstring::npos && !prefix.empty() && std::wstring(L"*?{").find(pattern[end]) != std::wstring::npos)
+    {
+        prefix.pop_back();
+    }
+    return prefix;
+}
+
+// UNDNAME_COMPLETE and UNDNAME_NAME_ONLY from dbghelp.h, which is not needed otherwise
+constexpr DWORD undname_complete = 0;
+constexpr DWORD undname_name_only = 0x1000;
+
+static std::wstring FoldCase(const std::wstring& in)
+{
+    std::wstring ret(in);
+    for (auto& c : ret)
+    {
+        c = (wchar_t)std::towlower(c);
+    }
+    return ret;
+}
+
+// runs fn(i) for every i in [0, count) on up to threads workers (0: one per hardware thread).
+// workers join the multithreaded apartment, so each of them can use its own readers.
+// the first exception thrown by fn is rethrown once all workers are done.
+static void ParallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& fn)
+{
+    if (!threads)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::min<size_t>(threads, std::max<size_t>(1, count));
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex error_lock;
+    auto worker = [&]() {
+        HRESULT init = PDBReader::CoInit();
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                fn(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        // RPC_E_CHANGED_MODE and friends leave nothing to balance
+        if (SUCCEEDED(init))
+        {
+            CoUninitialize();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    for (auto& t : pool)
+    {
+        t.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+static uint64_t HashCombine(uint64_t hash, uint64_t value)
+{
+    value *= 0x9e3779b97f4a7c15;
+    value ^= value >> 29;
+    return (hash ^ value) * 0x100000001b3;
+}
+
+// bits per name and probes per lookup give a false positive rate below 1%
+constexpr uint64_t symbol_name_filter_bits_per_name = 10;
+constexpr uint64_t symbol_name_filter_probes = 7;
+
 PDBReader::PDBReader(std::wstring pdb_name)
 {
     CComPtr<IDiaDataSource> pSource;
@@ -66,13 +520,31 @@ PDBReader::PDBReader(std::wstring executable_name, std::wstring search_path)
 
 std::optional<DWORD> PDBReader::FindSymbol(std::wstring sym, DWORD& type)
 {
+    PDBREADER_STATS_API(FindSymbol);
     // lookup in cache
     // it seems that com api such as findchildren() will also cache its result. 
     // however, as I don't find any document about this we keep our simple cache system here.
     if (symbolRVACache.find(sym) != symbolRVACache.end())
     {
+        PDBREADER_STATS_CACHE(SymbolRVA, Hit);
         return symbolRVACache[sym];
     }
+    PDBREADER_STATS_CACHE(SymbolRVA, Miss);
+    if (symbolMissCache.find(sym) != symbolMissCache.end())
+    {
+        PDBREADER_STATS_CACHE(SymbolMiss, Hit);
+        return {};
+    }
+    PDBREADER_STATS_CACHE(SymbolMiss, Miss);
+    if (!symbolNameFilter.empty())
+    {
+        if (!SymbolNameFilterMayContain(sym))
+        {
+            PDBREADER_STATS_CACHE(SymbolNameFilter, Hit);
+            return {};
+        }
+        PDBREADER_STATS_CACHE(SymbolNameFilter, Miss);
+    }
 
     CComPtr<IDiaEnumSymbols> pEnumSymbols;
     HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagNull, sym.c_str(), nsfCaseSensitive, &pEnumSymbols);
@@ -82,8 +554,15 @@ std::optional<DWORD> PDBReader::FindSymbol(std::wstring sym, DWORD& type)
     }
     LONG count = 0;
     hr = pEnumSymbols->get_Count(&count);
-    if (count != 1 || (FAILED(hr)))
+    if (FAILED(hr))
+    {
+        return {};
+    }
+    if (count != 1)
     {
+        // the answer won't change for this pdb, so remember the name to fail fast next time
+        symbolMissCache.insert(sym);
+        PDBREADER_STATS_CACHE(SymbolMiss, Insert);
         return {};
     }
     CComPtr<IDiaSymbol> pSymbol;
@@ -106,377 +585,2724 @@ std::optional<DWORD> PDBReader::FindSymbol(std::wstring sym, DWORD& type)
     if (symbolRVACache.find(sym) == symbolRVACache.end())
     {
         symbolRVACache[sym] = rva;
+        PDBREADER_STATS_CACHE(SymbolRVA, Insert);
     }
     return rva;
 }
 
-std::optional<DWORD> PDBReader::FindConst(std::wstring const_name)
-{
-    DWORD type = SymTagEnum::SymTagData;
-    return FindSymbol(const_name, type);
-}
-
-std::optional<DWORD> PDBReader::FindFunction(std::wstring func)
-{
-    DWORD type = SymTagEnum::SymTagFunction;
-    return FindSymbol(func, type);
-}
-
-std::optional<DWORD> PDBReader::FindStructMemberOffset(std::wstring structName, std::wstring memberName)
+std::vector<PDBReader::SymbolInfo> PDBReader::FindSymbols(const std::wstring& sym, enum SymTagEnum tag)
 {
     CComPtr<IDiaEnumSymbols> pEnumSymbols;
-    HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagUDT, structName.c_str(), nsfCaseSensitive, &pEnumSymbols);
+    HRESULT hr = pGlobal->findChildren(tag, sym.c_str(), nsfCaseSensitive, &pEnumSymbols);
     if (FAILED(hr))
     {
         return {};
     }
     LONG count = 0;
     hr = pEnumSymbols->get_Count(&count);
-    if (count != 1 || (FAILED(hr)))
+    if (FAILED(hr) || count <= 0)
     {
         return {};
     }
-    CComPtr<IDiaSymbol> pSymbol;
-    ULONG celt = 1;
-    hr = pEnumSymbols->Next(1, &pSymbol, &celt);
-    if ((FAILED(hr)) || (celt != 1))
+    std::vector<SymbolInfo> ret;
+    ret.reserve(count);
+    for (;;)
     {
-        return {};
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        SymbolInfo info = {};
+        if (FAILED(pSymbol->get_symIndexId(&info.sym_index_id)) || FAILED(pSymbol->get_symTag(&info.tag)))
+        {
+            continue;
+        }
+        // types have neither an address nor (for forward declarations) a length, leave them zero
+        if (FAILED(pSymbol->get_relativeVirtualAddress(&info.rva)))
+        {
+            info.rva = 0;
+        }
+        if (FAILED(pSymbol->get_length(&info.length)))
+        {
+            info.length = 0;
+        }
+        info.name = sym;
+        ret.push_back(info);
     }
-    CComPtr<IDiaEnumSymbols> structEnumSymbols;
-    hr = pSymbol->findChildren(SymTagEnum::SymTagNull, memberName.c_str(), nsfCaseSensitive, &structEnumSymbols);
-    if (FAILED(hr))
+    return ret;
+}
+
+std::optional<PDBReader::SymbolInfo> PDBReader::FindBestSymbol(const std::wstring& sym, enum SymTagEnum tag)
+{
+    auto matches = FindSymbols(sym, tag);
+    if (matches.empty())
     {
         return {};
     }
-    count = 0;
-    hr = structEnumSymbols->get_Count(&count);
-    if (count != 1 || (FAILED(hr)))
+    auto best = matches.begin();
+    for (auto itr = matches.begin(); itr != matches.end(); itr++)
     {
-        return {};
+        if (itr->length > best->length)
+        {
+            best = itr;
+        }
     }
-    CComPtr<IDiaSymbol> memberSymbol;
-    celt = 1;
-    hr = structEnumSymbols->Next(1, &memberSymbol, &celt);
-    if ((FAILED(hr)) || (celt != 1))
+    return *best;
+}
+
+size_t PDBReader::SearchSymbols(const std::wstring& pattern, SearchMode mode, const std::function<bool(const SymbolInfo&)>& callback,
+    enum SymTagEnum tag, size_t limit)
+{
+    PDBREADER_STATS_API(SearchSymbols);
+    if (SortedSymbolNameIndex.empty())
     {
-        return {};
+        BuildSortedSymbolNameIndex();
     }
-    LONG offset = 0;
-    hr = memberSymbol->get_offset(&offset);
-    if (FAILED(hr))
+    std::wregex re;
+    if (mode == SearchMode::Regex)
     {
-        return {};
+        re = std::wregex(pattern);
     }
-    return offset;
+    auto prefix = LiteralPrefix(pattern, mode);
+    auto itr = std::lower_bound(SortedSymbolNameIndex.begin(), SortedSymbolNameIndex.end(), prefix,
+        [](const SymbolInfo& info, const std::wstring& key) { return info.name < key; });
+    size_t found = 0;
+    for (; itr != SortedSymbolNameIndex.end() && found < limit; itr++)
+    {
+        if (itr->name.compare(0, prefix.size(), prefix) != 0)
+        {
+            break;
+        }
+        if (tag != SymTagNull && itr->tag != (DWORD)tag)
+        {
+            continue;
+        }
+        if (mode == SearchMode::Wildcard && !WildcardMatch(itr->name.c_str(), pattern.c_str()))
+        {
+            continue;
+        }
+        if (mode == SearchMode::Regex && !std::regex_match(itr->name, re))
+        {
+            continue;
+        }
+        found++;
+        if (!callback(*itr))
+        {
+            break;
+        }
+    }
+    return found;
 }
 
-std::optional<UINT64> PDBReader::FindStructSize(std::wstring structName)
+std::vector<PDBReader::SymbolInfo> PDBReader::FindSymbolsCaseInsensitive(const std::wstring& name)
 {
-    CComPtr<IDiaEnumSymbols> pEnumSymbols;
-    HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagUDT, structName.c_str(), nsfCaseSensitive, &pEnumSymbols);
-    if (FAILED(hr))
-    {
-        return {};
-    }
-    LONG count = 0;
-    hr = pEnumSymbols->get_Count(&count);
-    if (count != 1 || (FAILED(hr)))
+    if (!alternateNameIndexesBuilt)
     {
-        return {};
+        BuildAlternateNameIndexes();
     }
-    CComPtr<IDiaSymbol> pSymbol;
-    ULONG celt = 1;
-    hr = pEnumSymbols->Next(1, &pSymbol, &celt);
-    if ((FAILED(hr)) || (celt != 1))
+    auto itr = caseFoldedNameIndex.find(FoldCase(name));
+    if (itr == caseFoldedNameIndex.end())
     {
         return {};
     }
-    UINT64 size;
-    hr = pSymbol->get_length(&size);
-    if (FAILED(hr))
+    std::vector<SymbolInfo> ret;
+    for (auto pos : itr->second)
     {
-        return {};
+        ret.push_back(SortedSymbolNameIndex[pos]);
     }
-    return size;
+    return ret;
 }
 
-bool PDBReader::FindMostRelatedFunctionName(DWORD rva, std::wstring& funcname)
+std::vector<PDBReader::SymbolInfo> PDBReader::FindSymbolsByUndecoratedName(const std::wstring& name)
 {
-    if (!SortedFunctionRVANameList.size())
+    if (!alternateNameIndexesBuilt)
     {
-        BuildSortedFunctionRVANameList();
+        BuildAlternateNameIndexes();
     }
-    if (std::get<0>(*SortedFunctionRVANameList.begin()) > rva)
+    auto itr = undecoratedNameIndex.find(FoldCase(name));
+    if (itr == undecoratedNameIndex.end())
     {
-        return false;
+        return {};
     }
-    for (auto itr = SortedFunctionRVANameList.begin(); itr != SortedFunctionRVANameList.end(); itr++)
+    std::vector<SymbolInfo> ret;
+    for (auto pos : itr->second)
     {
-        auto next = std::next(itr, 1);
-        if (next == SortedFunctionRVANameList.end())
-        {
-            funcname = std::get<1>(*itr);
-            return true;
-        }
-        else if (std::get<0>(*next) > rva)
-        {
-            funcname = std::get<1>(*itr);
-            return true;
-        }
+        ret.push_back(SortedSymbolNameIndex[pos]);
     }
+    return ret;
 }
 
-void PDBReader::FindNearestSymbolFromRVA(DWORD rva, std::wstring& symbolName, DWORD& symbolType)
+std::vector<PDBReader::SymbolInfo> PDBReader::FindSymbolsAnySpelling(const std::wstring& name)
 {
-    CComPtr<IDiaSymbol> target;
-    HRESULT hr = pSession->findSymbolByRVA(rva, SymTagEnum::SymTagNull, &target);
-    if (FAILED(hr))
+    PDBREADER_STATS_API(FindSymbolsAnySpelling);
+    if (!alternateNameIndexesBuilt)
     {
-        throw std::exception("findSymbolByRVA() failed.");
+        BuildAlternateNameIndexes();
     }
-    hr = target->get_symTag(&symbolType);
-    if (FAILED(hr))
+    auto key = FoldCase(name);
+    std::vector<uint32_t> positions;
+    for (auto index : { &caseFoldedNameIndex, &undecoratedNameIndex })
     {
-        throw std::exception("get_symTag() failed.");
+        auto itr = index->find(key);
+        if (itr != index->end())
+        {
+            positions.insert(positions.end(), itr->second.begin(), itr->second.end());
+        }
     }
-    hr = target->get_relativeVirtualAddress(&rva);
-    if (FAILED(hr))
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+    std::vector<SymbolInfo> ret;
+    for (auto pos : positions)
     {
-        throw std::exception("get_relativeVirtualAddress() failed.");
+        ret.push_back(SortedSymbolNameIndex[pos]);
     }
-    BSTR bstrName;
-    hr = target->get_name(&bstrName);
-    if (FAILED(hr))
+    std::stable_partition(ret.begin(), ret.end(), [&](const SymbolInfo& info) { return info.name == name; });
+    return ret;
+}
+
+std::optional<DWORD> PDBReader::FindConst(std::wstring const_name)
+{
+    DWORD type = SymTagEnum::SymTagData;
+    return FindSymbol(const_name, type);
+}
+
+static std::optional<int64_t> VariantToInt64(const VARIANT& value)
+{
+    switch (value.vt)
+    {
+    case VT_I1:
+        return value.cVal;
+    case VT_I2:
+        return value.iVal;
+    case VT_I4:
+        return value.lVal;
+    case VT_INT:
+        return value.intVal;
+    case VT_I8:
+        return value.llVal;
+    case VT_UI1:
+        return value.bVal;
+    case VT_UI2:
+        return value.uiVal;
+    case VT_UI4:
+        return value.ulVal;
+    case VT_UINT:
+        return value.uintVal;
+    case VT_UI8:
+        return (int64_t)value.ullVal;
+    default:
+        return {};
+    }
+}
+
+std::optional<int64_t> PDBReader::EnumValues::FindValue(const std::wstring& enumerator) const
+{
+    auto it = by_name.find(enumerator);
+    if (it == by_name.end())
     {
-        throw std::exception("get_name() failed.");
+        return {};
     }
-    symbolName = bstrName;
-    SysFreeString(bstrName);
-    return;
+    return values[it->second];
 }
 
-void PDBReader::DumpTypes(enum SymTagEnum type, const std::wstring out_file)
+const std::wstring* PDBReader::EnumValues::FindName(int64_t value) const
 {
-    std::ofstream out;
-    out.open(out_file, std::ofstream::binary);
-    if (!out.is_open())
+    auto it = std::lower_bound(by_value.begin(), by_value.end(), std::make_pair(value, (uint32_t)0));
+    if (it == by_value.end() || it->first != value)
     {
-        throw std::exception("cannot create file for output");
+        return nullptr;
     }
+    return &names[it->second];
+}
+
+bool PDBReader::ReadEnumValues(IDiaSymbol* sym, EnumValues& out)
+{
     CComPtr<IDiaEnumSymbols> pEnumSymbols;
-    HRESULT hr = pGlobal->findChildren(type, 0, nsfCaseSensitive, &pEnumSymbols);
-    if (FAILED(hr))
+    if (FAILED(sym->findChildren(SymTagEnum::SymTagData, 0, nsNone, &pEnumSymbols)))
     {
-        throw std::exception("findChildren() with null name failed.");
+        return false;
     }
-    LONG count = 0;
-    hr = pEnumSymbols->get_Count(&count);
-    if (count == 0 || (FAILED(hr)))
+    for (;;)
     {
-        throw std::exception("get_Count() failed or returned zero");
+        CComPtr<IDiaSymbol> enumerator;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &enumerator, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        CComBSTR tmp_name;
+        if (FAILED(enumerator->get_name(&tmp_name)) || !tmp_name.m_str)
+        {
+            continue;
+        }
+        VARIANT value;
+        VariantInit(&value);
+        if (FAILED(enumerator->get_value(&value)))
+        {
+            continue;
+        }
+        auto number = VariantToInt64(value);
+        VariantClear(&value);
+        if (!number)
+        {
+            continue;
+        }
+        out.by_name.emplace(tmp_name.m_str, (uint32_t)out.names.size());
+        out.by_value.push_back({ *number, (uint32_t)out.names.size() });
+        out.names.push_back(tmp_name.m_str);
+        out.values.push_back(*number);
     }
+    std::sort(out.by_value.begin(), out.by_value.end());
+    return true;
+}
 
-    printf("total %d types to dump\n", count);
+const PDBReader::EnumValues* PDBReader::GetEnum(const std::wstring& enumName)
+{
+    PDBREADER_STATS_API(GetEnum);
+    auto cached = enumCache.find(enumName);
+    if (cached != enumCache.end())
+    {
+        PDBREADER_STATS_CACHE(Enum, Hit);
+        return &cached->second;
+    }
+    PDBREADER_STATS_CACHE(Enum, Miss);
+    auto best = FindBestSymbol(enumName, SymTagEnum::SymTagEnum);
+    if (!best)
+    {
+        return nullptr;
+    }
+    CComPtr<IDiaSymbol> pSymbol;
+    if (FAILED(pSession->symbolById(best->sym_index_id, &pSymbol)))
+    {
+        return nullptr;
+    }
+    EnumValues values;
+    values.name = enumName;
+    if (!ReadEnumValues(pSymbol, values))
+    {
+        return nullptr;
+    }
+    auto& ret = enumCache[enumName] = std::move(values);
+    PDBREADER_STATS_CACHE(Enum, Insert);
+    return &ret;
+}
 
-    for (int i = 0; ; i += 1)
+std::optional<int64_t> PDBReader::FindEnumValue(const std::wstring& enumName, const std::wstring& enumerator)
+{
+    auto values = GetEnum(enumName);
+    if (!values)
     {
-        if ((i % 100) == 0)
+        return {};
+    }
+    return values->FindValue(enumerator);
+}
+
+const std::wstring* PDBReader::FindEnumName(const std::wstring& enumName, int64_t value)
+{
+    auto values = GetEnum(enumName);
+    if (!values)
+    {
+        return nullptr;
+    }
+    return values->FindName(value);
+}
+
+std::optional<int64_t> PDBReader::FindConstantValue(const std::wstring& name)
+{
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagData, name.c_str(), nsfCaseSensitive, &pEnumSymbols)))
+    {
+        return {};
+    }
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
         {
-            printf("progress: %d / %d\n", i, count);
+            break;
+        }
+        DWORD location_type;
+        if (FAILED(pSymbol->get_locationType(&location_type)) || location_type != LocIsConstant)
+        {
+            continue;
+        }
+        VARIANT value;
+        VariantInit(&value);
+        if (FAILED(pSymbol->get_value(&value)))
+        {
+            continue;
         }
+        auto number = VariantToInt64(value);
+        VariantClear(&value);
+        if (number)
+        {
+            return number;
+        }
+    }
+    return {};
+}
+
+void PDBReader::DumpEnums(const std::wstring& out_file)
+{
+    std::ofstream out;
+    out.open(out_file, std::ofstream::binary);
+    if (!out.is_open())
+    {
+        throw std::exception("cannot create file for output");
+    }
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagEnum, 0, nsNone, &pEnumSymbols)))
+    {
+        throw std::exception("findChildren() with null name failed.");
+    }
+    // an enum has a type record in every module which uses it. the copies are told apart by their
+    // enumerators rather than by name alone, so distinct anonymous enums ("<unnamed-tag>") all get written.
+    std::set<std::tuple<std::wstring, std::vector<std::wstring>, std::vector<int64_t>>> written;
+    for (;;)
+    {
         CComPtr<IDiaSymbol> pSymbol;
         ULONG celt = 1;
-        hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
         if ((FAILED(hr)) || (celt != 1))
         {
             break;
         }
-        DWORD rva = 0;
-        hr = pSymbol->get_relativeVirtualAddress(&rva);
-        if (FAILED(hr))
+        CComBSTR tmp_name;
+        if (FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str)
         {
             continue;
         }
-        CComBSTR tmp_name;
-        hr = pSymbol->get_name(&tmp_name);
-        if (FAILED(hr))
+        EnumValues values;
+        if (!ReadEnumValues(pSymbol, values) || values.names.empty())
+        {
+            continue;
+        }
+        if (!written.emplace(tmp_name.m_str, values.names, values.values).second)
         {
             continue;
         }
         auto name = wstring2stringbytruncation(tmp_name.m_str);
-        out.write(name.c_str(), name.size());
-        out.write("\t", 1);
-        auto addr = std::to_string(rva);
-        out.write(addr.c_str(), addr.size());
-        out.write("\n", 1);
+        for (size_t i = 0; i < values.names.size(); i++)
+        {
+            out << name << "\t" << wstring2stringbytruncation(values.names[i]) << "\t" << values.values[i] << "\n";
+        }
     }
 }
 
-const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(const std::wstring& structName)
+PdbFile* PDBReader::GetPdbFile()
 {
-    CComPtr<IDiaEnumSymbols> pEnumSymbols;
-    HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagUDT, structName.c_str(), nsfCaseSensitive, &pEnumSymbols);
+    if (!pdbFileOpened)
+    {
+        pdbFileOpened = true;
+        CComBSTR file_name;
+        if (SUCCEEDED(pGlobal->get_symbolsFileName(&file_name)) && file_name.m_str)
+        {
+            try
+            {
+                pdbFile = std::make_unique<PdbFile>(file_name.m_str);
+            }
+            catch (std::exception&)
+            {
+                // left null, callers report the type as unknown
+            }
+        }
+    }
+    return pdbFile.get();
+}
+
+std::optional<PDBReader::SourceLocation> PDBReader::FindTypeSource(const std::wstring& typeName)
+{
+    auto pdb = GetPdbFile();
+    if (!pdb)
+    {
+        return {};
+    }
+    auto type_index = pdb->FindUDTTypeIndex(wstring2stringbytruncation(typeName));
+    if (!type_index)
+    {
+        return {};
+    }
+    auto source = pdb->FindTypeSource(*type_index);
+    if (!source)
+    {
+        return {};
+    }
+    return SourceLocation{ Utf8ToWstring(source->file), source->line };
+}
+
+void PDBReader::DumpTypeSources(const std::wstring& out_file)
+{
+    std::ofstream out;
+    out.open(out_file, std::ofstream::binary);
+    if (!out.is_open())
+    {
+        throw std::exception("cannot create file for output");
+    }
+    auto pdb = GetPdbFile();
+    if (!pdb)
+    {
+        throw std::exception("Could not open pdb file.");
+    }
+    for (uint32_t type_index = pdb->TypeBegin(); type_index < pdb->TypeEnd(); type_index++)
+    {
+        auto source = pdb->FindTypeSource(type_index);
+        auto name = source ? pdb->FindUDTName(type_index) : nullptr;
+        if (name)
+        {
+            out << name << "\t" << source->file << "\t" << source->line << "\n";
+        }
+    }
+}
+
+std::vector<PDBReader::LocalInfo> PDBReader::FindLocalsFromRVA(DWORD rva)
+{
+    PDBREADER_STATS_API(FindLocalsFromRVA);
+    auto pdb = GetPdbFile();
+    DWORD section = 0;
+    DWORD offset = 0;
+    if (!pdb || FAILED(pSession->addressForRVA(rva, &section, &offset)))
+    {
+        return {};
+    }
+    std::vector<LocalInfo> ret;
+    for (auto& local : pdb->FindLocals((uint16_t)section, offset))
+    {
+        ret.push_back({ Utf8ToWstring(local.name), local.type_index, local.is_parameter,
+            local.register_id, local.register_relative, local.offset });
+    }
+    return ret;
+}
+
+std::optional<DWORD> PDBReader::FindFunction(std::wstring func)
+{
+    DWORD type = SymTagEnum::SymTagFunction;
+    return FindSymbol(func, type);
+}
+
+std::optional<DWORD> PDBReader::FindStructMemberOffset(std::wstring structName, std::wstring memberName)
+{
+    PDBREADER_STATS_API(FindStructMemberOffset);
+    auto pSymbol = FindUDT(structName);
+    if (!pSymbol)
+    {
+        return {};
+    }
+    CComPtr<IDiaEnumSymbols> structEnumSymbols;
+    HRESULT hr = pSymbol->findChildren(SymTagEnum::SymTagNull, memberName.c_str(), nsfCaseSensitive, &structEnumSymbols);
     if (FAILED(hr))
     {
         return {};
     }
     LONG count = 0;
-    hr = pEnumSymbols->get_Count(&count);
+    hr = structEnumSymbols->get_Count(&count);
     if (count != 1 || (FAILED(hr)))
     {
         return {};
     }
-    CComPtr<IDiaSymbol> pSymbol;
+    CComPtr<IDiaSymbol> memberSymbol;
     ULONG celt = 1;
-    hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+    hr = structEnumSymbols->Next(1, &memberSymbol, &celt);
     if ((FAILED(hr)) || (celt != 1))
     {
         return {};
     }
-    return GetStructureFields(pSymbol);
+    LONG offset = 0;
+    hr = memberSymbol->get_offset(&offset);
+    if (FAILED(hr))
+    {
+        return {};
+    }
+    return offset;
 }
 
-const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(DWORD symbolId)
+std::optional<UINT64> PDBReader::FindStructSize(std::wstring structName)
 {
-    CComPtr<IDiaSymbol> pSymbol;
-    if (FAILED(pSession->symbolById(symbolId, &pSymbol)))
+    PDBREADER_STATS_API(FindStructSize);
+    auto pSymbol = FindUDT(structName);
+    if (!pSymbol)
     {
         return {};
     }
-    return GetStructureFields(pSymbol);
+    UINT64 size;
+    HRESULT hr = pSymbol->get_length(&size);
+    if (FAILED(hr))
+    {
+        return {};
+    }
+    return size;
 }
 
-HRESULT PDBReader::CoInit(DWORD init_flag)
+std::vector<PDBReader::MemberResult> PDBReader::ResolveOffsets(const std::vector<MemberQuery>& queries)
 {
-    return CoInitializeEx(0, init_flag);
+    PDBREADER_STATS_API(ResolveOffsets);
+    std::vector<MemberResult> results(queries.size(), { MemberResult::Status::StructNotFound, 0, 0, 0 });
+
+    // structure -> indexes of its queries
+    std::map<std::wstring, std::vector<size_t>> groups;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        groups[queries[i].struct_name].push_back(i);
+    }
+
+    std::unordered_map<std::wstring, const FieldInfo*> members;
+    for (auto& group : groups)
+    {
+        auto pSymbol = FindUDT(group.first);
+        if (!pSymbol)
+        {
+            continue;
+        }
+        // one unreadable member must not hide the others
+        std::vector<std::wstring> failed;
+        auto fields = ReadStructureFields(pSymbol, failed);
+        members.clear();
+        for (auto& field : fields)
+        {
+            members.emplace(field.name, &field);
+        }
+        for (auto i : group.second)
+        {
+            auto member = members.find(queries[i].member);
+            if (member == members.end())
+            {
+                // the enumeration skipped it, a lookup by name may still get at its offset
+                auto offset = failed.empty() ? std::nullopt : FindStructMemberOffset(group.first, queries[i].member);
+                results[i] = { offset ? MemberResult::Status::Found : MemberResult::Status::MemberNotFound, offset.value_or(0), 0, 0 };
+                continue;
+            }
+            results[i] = { MemberResult::Status::Found, member->second->offset, member->second->bit_position, member->second->bit_length };
+        }
+    }
+    return results;
 }
 
-void PDBReader::SetMsdiaDllPath(std::wstring p)
+bool PDBReader::FindMostRelatedFunctionName(DWORD rva, std::wstring& funcname)
 {
-    dia_dll_full_path = p;
+    PDBREADER_STATS_API(FindMostRelatedFunctionName);
+    if (!SortedFunctionRVANameList.size())
+    {
+        BuildSortedFunctionRVANameList();
+    }
+    // the last function starting at or below rva
+    auto itr = std::upper_bound(SortedFunctionRVANameList.begin(), SortedFunctionRVANameList.end(), rva,
+        [](DWORD value, const std::tuple<uint32_t, std::wstring>& function) { return value < std::get<0>(function); });
+    if (itr == SortedFunctionRVANameList.begin())
+    {
+        return false;
+    }
+    funcname = std::get<1>(*std::prev(itr));
+    return true;
 }
 
-const PDBReader::TypeInfo PDBReader::GetTypeInfo(DWORD symbolId)
+std::vector<std::wstring> PDBReader::FindFunctionsFromRVAs(const std::vector<DWORD>& rvas)
+{
+    if (!SortedFunctionRVANameList.size())
+    {
+        BuildSortedFunctionRVANameList();
+    }
+    // visit the addresses in ascending order, so the list is walked once instead of searched per address
+    std::vector<uint32_t> order(rvas.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rvas[a] < rvas[b]; });
+
+    std::vector<std::wstring> ret(rvas.size());
+    size_t next = 0;
+    for (auto i : order)
+    {
+        while (next < SortedFunctionRVANameList.size() && std::get<0>(SortedFunctionRVANameList[next]) <= rvas[i])
+        {
+            next++;
+        }
+        if (next)
+        {
+            ret[i] = std::get<1>(SortedFunctionRVANameList[next - 1]);
+        }
+    }
+    return ret;
+}
+
+void PDBReader::FindNearestSymbolFromRVA(DWORD rva, std::wstring& symbolName, DWORD& symbolType)
+{
+    PDBREADER_STATS_API(FindNearestSymbolFromRVA);
+    CComPtr<IDiaSymbol> target;
+    HRESULT hr = pSession->findSymbolByRVA(rva, SymTagEnum::SymTagNull, &target);
+    if (FAILED(hr))
+    {
+        throw std::exception("findSymbolByRVA() failed.");
+    }
+    hr = target->get_symTag(&symbolType);
+    if (FAILED(hr))
+    {
+        throw std::exception("get_symTag() failed.");
+    }
+    hr = target->get_relativeVirtualAddress(&rva);
+    if (FAILED(hr))
+    {
+        throw std::exception("get_relativeVirtualAddress() failed.");
+    }
+    BSTR bstrName;
+    hr = target->get_name(&bstrName);
+    if (FAILED(hr))
+    {
+        throw std::exception("get_name() failed.");
+    }
+    symbolName = bstrName;
+    SysFreeString(bstrName);
+    return;
+}
+
+const std::vector<PDBReader::VariableInfo>& PDBReader::GetGlobalVariables()
+{
+    if (!globalVariableTableBuilt)
+    {
+        BuildGlobalVariableTable();
+    }
+    return globalVariables;
+}
+
+std::optional<PDBReader::VariableInfo> PDBReader::FindVariableFromRVA(DWORD rva, DWORD& offset)
+{
+    auto index = FindVariablesFromRVAs({ rva })[0];
+    if (index == no_variable)
+    {
+        return {};
+    }
+    offset = rva - globalVariables[index].rva;
+    return globalVariables[index];
+}
+
+std::vector<uint32_t> PDBReader::FindVariablesFromRVAs(const std::vector<DWORD>& rvas)
+{
+    if (!globalVariableTableBuilt)
+    {
+        BuildGlobalVariableTable();
+    }
+    // visit the addresses in ascending order, so the table is walked once instead of searched per address
+    std::vector<uint32_t> order(rvas.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rvas[a] < rvas[b]; });
+
+    std::vector<uint32_t> ret(rvas.size(), no_variable);
+    size_t next = 0;
+    for (auto i : order)
+    {
+        while (next < globalVariableRVAs.size() && globalVariableRVAs[next] <= rvas[i])
+        {
+            next++;
+        }
+        // globalVariables[next - 1] is the largest of the last variables starting at or below the address,
+        // a variable of unknown size only covers its own address
+        if (next && (rvas[i] == globalVariableRVAs[next - 1] || rvas[i] - globalVariableRVAs[next - 1] < globalVariables[next - 1].size))
+        {
+            ret[i] = (uint32_t)(next - 1);
+        }
+    }
+    return ret;
+}
+
+void PDBReader::BuildGlobalVariableTable()
+{
+    PDBREADER_STATS_INDEX_BUILD(GlobalVariableTable);
+    globalVariableTableBuilt = true;
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagData, 0, nsNone, &pEnumSymbols)))
+    {
+        return;
+    }
+    std::vector<VariableInfo> variables;
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        // constants and thread locals have no rva of their own
+        DWORD location_type;
+        if (FAILED(pSymbol->get_locationType(&location_type)) || location_type != LocIsStatic)
+        {
+            continue;
+        }
+        VariableInfo info = {};
+        CComBSTR tmp_name;
+        DWORD data_kind;
+        if (FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str
+            || FAILED(pSymbol->get_relativeVirtualAddress(&info.rva))
+            || FAILED(pSymbol->get_addressSection(&info.section))
+            || FAILED(pSymbol->get_addressOffset(&info.offset))
+            || FAILED(pSymbol->get_dataKind(&data_kind))
+            || FAILED(pSymbol->get_typeId(&info.type_id)))
+        {
+            continue;
+        }
+        info.name = tmp_name.m_str;
+        info.is_static = data_kind == DataIsFileStatic;
+        info.type = GetTypeInfo(info.type_id);
+        info.size = info.type.size;
+        // arrays without a bound and linker defined markers have no type size, the symbol may still know its length
+        ULONGLONG length = 0;
+        if (!info.size && SUCCEEDED(pSymbol->get_length(&length)))
+        {
+            info.size = length;
+        }
+        variables.push_back(std::move(info));
+    }
+    std::sort(variables.begin(), variables.end(), [](const VariableInfo& a, const VariableInfo& b) {
+        return a.rva < b.rva || (a.rva == b.rva && (a.name < b.name || (a.name == b.name && a.size > b.size)));
+        });
+    // the same variable can be listed by more than one module, the listing with the largest size is kept
+    variables.erase(std::unique(variables.begin(), variables.end(), [](const VariableInfo& a, const VariableInfo& b) {
+        return a.rva == b.rva && a.name == b.name;
+        }), variables.end());
+    // of the variables sharing an address the largest goes last, which is the one lookups check
+    std::stable_sort(variables.begin(), variables.end(), [](const VariableInfo& a, const VariableInfo& b) {
+        return a.rva < b.rva || (a.rva == b.rva && a.size < b.size);
+        });
+    globalVariableRVAs.clear();
+    for (auto& variable : variables)
+    {
+        globalVariableRVAs.push_back(variable.rva);
+    }
+    globalVariables = std::move(variables);
+}
+
+void PDBReader::DumpTypes(enum SymTagEnum type, const std::wstring out_file, bool undecorate)
+{
+    PDBREADER_STATS_API(DumpTypes);
+    std::ofstream out;
+    out.open(out_file, std::ofstream::binary);
+    if (!out.is_open())
+    {
+        throw std::exception("cannot create file for output");
+    }
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    HRESULT hr = pGlobal->findChildren(type, 0, nsfCaseSensitive, &pEnumSymbols);
+    if (FAILED(hr))
+    {
+        throw std::exception("findChildren() with null name failed.");
+    }
+    LONG count = 0;
+    hr = pEnumSymbols->get_Count(&count);
+    if (count == 0 || (FAILED(hr)))
+    {
+        throw std::exception("get_Count() failed or returned zero");
+    }
+
+    printf("total %d types to dump\n", count);
+
+    for (int i = 0; ; i += 1)
+    {
+        if ((i % 100) == 0)
+        {
+            printf("progress: %d / %d\n", i, count);
+        }
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        DWORD rva = 0;
+        hr = pSymbol->get_relativeVirtualAddress(&rva);
+        if (FAILED(hr))
+        {
+            continue;
+        }
+        CComBSTR tmp_name;
+        hr = pSymbol->get_name(&tmp_name);
+        if (FAILED(hr))
+        {
+            continue;
+        }
+        auto name = wstring2stringbytruncation(tmp_name.m_str);
+        out.write(name.c_str(), name.size());
+        out.write("\t", 1);
+        auto addr = std::to_string(rva);
+        out.write(addr.c_str(), addr.size());
+        if (undecorate)
+        {
+            auto undecorated = wstring2stringbytruncation(UndecorateSymbol(pSymbol, tmp_name.m_str));
+            out.write("\t", 1);
+            out.write(undecorated.c_str(), undecorated.size());
+        }
+        out.write("\n", 1);
+    }
+}
+
+std::wstring PDBReader::UndecorateName(const SymbolInfo& sym)
+{
+    CComPtr<IDiaSymbol> pSymbol;
+    if (FAILED(pSession->symbolById(sym.sym_index_id, &pSymbol)))
+    {
+        return sym.name;
+    }
+    return UndecorateSymbol(pSymbol, sym.name);
+}
+
+std::wstring PDBReader::UndecorateSymbol(IDiaSymbol* sym, const std::wstring& name)
+{
+    // msvc decorated names start with '?', anything else is a C name or already undecorated
+    if (name.empty() || name[0] != L'?')
+    {
+        return name;
+    }
+    auto itr = undecoratedNameCache.find(name);
+    if (itr != undecoratedNameCache.end())
+    {
+        PDBREADER_STATS_CACHE(UndecoratedName, Hit);
+        return itr->second;
+    }
+    PDBREADER_STATS_CACHE(UndecoratedName, Miss);
+    CComBSTR undecorated;
+    if (sym->get_undecoratedNameEx(undname_complete, &undecorated) != S_OK || !undecorated.m_str)
+    {
+        return name;
+    }
+    std::wstring ret(undecorated.m_str);
+    undecoratedNameCache[name] = ret;
+    PDBREADER_STATS_CACHE(UndecoratedName, Insert);
+    return ret;
+}
+
+void PDBReader::BuildSymbolNameFilter()
+{
+    PDBREADER_STATS_INDEX_BUILD(SymbolNameFilter);
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagNull, 0, nsNone, &pEnumSymbols);
+    if (FAILED(hr))
+    {
+        throw std::exception("findChildren() with null name failed.");
+    }
+    LONG count = 0;
+    hr = pEnumSymbols->get_Count(&count);
+    if (FAILED(hr))
+    {
+        throw std::exception("get_Count() failed");
+    }
+    uint64_t words = ((uint64_t)count * symbol_name_filter_bits_per_name + 63) / 64;
+    std::vector<uint64_t> filter(words ? words : 1, 0);
+    uint64_t bits = filter.size() * 64;
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        CComBSTR tmp_name;
+        hr = pSymbol->get_name(&tmp_name);
+        if (FAILED(hr) || !tmp_name.m_str)
+        {
+            continue;
+        }
+        uint64_t hash = HashSymbolName(tmp_name.m_str, tmp_name.Length());
+        uint64_t step = (hash >> 33) | 1;
+        for (uint64_t i = 0; i < symbol_name_filter_probes; i++)
+        {
+            uint64_t bit = (hash + i * step) % bits;
+            filter[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+    symbolNameFilter = std::move(filter);
+}
+
+bool PDBReader::SymbolNameFilterMayContain(const std::wstring& name)
+{
+    uint64_t bits = symbolNameFilter.size() * 64;
+    uint64_t hash = HashSymbolName(name.c_str(), name.size());
+    uint64_t step = (hash >> 33) | 1;
+    for (uint64_t i = 0; i < symbol_name_filter_probes; i++)
+    {
+        uint64_t bit = (hash + i * step) % bits;
+        if (!(symbolNameFilter[bit / 64] & (1ull << (bit % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(const std::wstring& structName)
+{
+    auto pSymbol = FindUDT(structName);
+    if (!pSymbol)
+    {
+        return {};
+    }
+    return GetStructureFields(pSymbol);
+}
+
+const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(DWORD symbolId)
+{
+    CComPtr<IDiaSymbol> pSymbol;
+    if (FAILED(pSession->symbolById(symbolId, &pSymbol)))
+    {
+        return {};
+    }
+    return GetStructureFields(pSymbol);
+}
+
+HRESULT PDBReader::CoInit(DWORD init_flag)
+{
+    return CoInitializeEx(0, init_flag);
+}
+
+void PDBReader::SetMsdiaDllPath(std::wstring p)
+{
+    // only takes effect before the first reader is created, the loaded class factory is reused afterwards
+    std::lock_guard<std::mutex> lock(dia_factory_lock);
+    dia_dll_full_path = p;
+}
+
+const PDBReader::TypeInfo PDBReader::GetTypeInfo(DWORD symbolId)
+{
+    PDBREADER_STATS_API(GetTypeInfo);
+    if (symbolTypeInfoCache.find(symbolId) != symbolTypeInfoCache.end())
+    {
+        PDBREADER_STATS_CACHE(SymbolTypeInfo, Hit);
+        return symbolTypeInfoCache[symbolId];
+    }
+    PDBREADER_STATS_CACHE(SymbolTypeInfo, Miss);
+    CComPtr<IDiaSymbol> sym;
+    if (FAILED(pSession->symbolById(symbolId, &sym)))
+    {
+        return {};
+    }
+    DWORD tag;
+    if (FAILED(sym->get_symTag(&tag)))
+    {
+        return {};
+    }
+    ULONGLONG size;
+    if (FAILED(sym->get_length(&size)) || !size)
+    {
+        return {};
+    }
+    DWORD id;
+    if (FAILED(sym->get_symIndexId(&id)))
+    {
+        return {};
+    }
+    TypeInfo ret = {};
+    ret.attached_pdb = this;
+    ret.size = size;
+    ret.type = Types::Unknown;
+    ret.freindly_name = L"unknown";
+    ret.associated_type_obj_id = id;
+    switch (tag)
+    {
+    case SymTagUDT:
+    {
+        ret.type = Types::Class;
+        BSTR struct_name;
+        if (FAILED(sym->get_name(&struct_name)))
+        {
+            return {};
+        }
+        ret.freindly_name = struct_name;
+        SysFreeString(struct_name);
+        break;
+    }
+    case SymTagArrayType:
+    {
+        ret.type = Types::Array;
+        DWORD array_element_id;
+        if (FAILED(sym->get_typeId(&array_element_id)))
+        {
+            return {};
+        }
+        ret.arr_element_type_id = array_element_id;
+        auto element_type = GetTypeInfo(array_element_id);
+        if (!element_type.size)
+        {
+            return {};
+        }
+        if ((ret.size % element_type.size) != 0)
+        {
+            return {};
+        }
+        ret.arr_dim = ret.size / element_type.size;
+        ret.freindly_name = std::wstring(element_type.freindly_name) + L"[" + std::to_wstring(ret.arr_dim) + L"]";
+        break;
+    }
+    case SymTagBaseType:
+    {
+        DWORD base_type;
+        if (FAILED(sym->get_baseType(&base_type)))
+        {
+            break;
+        }
+        if (base_type == btChar || base_type == btChar8)
+        {
+            ret.type = Types::Char;
+            ret.freindly_name = L"char";
+            break;
+        }
+        else if (base_type == btWChar || base_type == btChar16)
+        {
+            ret.type = Types::Widechar;
+            ret.freindly_name = L"wchar";
+            break;
+        }
+        else if (base_type == btInt || base_type == btLong)
+        {
+            ret.type = Types::Integer;
+            ret.freindly_name = L"int" + std::to_wstring(ret.size * 8);
+            break;
+        }
+        else if (base_type == btUInt || base_type == btULong)
+        {
+            ret.type = Types::UInteger;
+            ret.freindly_name = L"uint" + std::to_wstring(ret.size * 8);
+            break;
+        }
+        else if (base_type == btFloat && ret.size == 4)
+        {
+            ret.type = Types::Float;
+            ret.freindly_name = L"float";
+            break;
+        }
+        else if (base_type == btFloat && ret.size == 8)
+        {
+            ret.type = Types::Double;
+            ret.freindly_name = L"double";
+            break;
+        }
+        break;
+    }
+    default:
+    {
+        break;
+    }
+    }
+    symbolTypeInfoCache[symbolId] = ret;
+    PDBREADER_STATS_CACHE(SymbolTypeInfo, Insert);
+    return ret;
+}
+
+uint64_t PDBReader::GetTypeHash(DWORD symbolId)
+{
+    auto itr = typeHashCache.find(symbolId);
+    if (itr != typeHashCache.end())
+    {
+        PDBREADER_STATS_CACHE(TypeHash, Hit);
+        return itr->second;
+    }
+    PDBREADER_STATS_CACHE(TypeHash, Miss);
+    CComPtr<IDiaSymbol> sym;
+    if (FAILED(pSession->symbolById(symbolId, &sym)))
+    {
+        return 0;
+    }
+    DWORD tag = SymTagNull;
+    sym->get_symTag(&tag);
+    ULONGLONG length = 0;
+    sym->get_length(&length);
+    uint64_t hash = HashCombine(HashCombine(0xcbf29ce484222325, tag), length);
+    switch (tag)
+    {
+    case SymTagBaseType:
+    case SymTagEnum:
+    {
+        // for enums this is the underlying type
+        DWORD base_type = 0;
+        sym->get_baseType(&base_type);
+        hash = HashCombine(hash, base_type);
+        break;
+    }
+    case SymTagArrayType:
+    {
+        DWORD element_id = 0;
+        DWORD element_count = 0;
+        sym->get_typeId(&element_id);
+        sym->get_count(&element_count);
+        hash = HashCombine(HashCombine(hash, element_count), GetTypeHash(element_id));
+        break;
+    }
+    case SymTagPointerType:
+    {
+        // the pointee doesn't change the layout, and following it could loop forever
+        BOOL reference = FALSE;
+        sym->get_reference(&reference);
+        hash = HashCombine(hash, reference);
+        break;
+    }
+    case SymTagUDT:
+    {
+        DWORD udt_kind = 0;
+        sym->get_udtKind(&udt_kind);
+        hash = HashCombine(hash, udt_kind);
+        CComPtr<IDiaEnumSymbols> pEnumSymbols;
+        if (FAILED(sym->findChildren(SymTagEnum::SymTagNull, 0, nsNone, &pEnumSymbols)))
+        {
+            break;
+        }
+        for (;;)
+        {
+            CComPtr<IDiaSymbol> child;
+            ULONG celt = 1;
+            if (FAILED(pEnumSymbols->Next(1, &child, &celt)) || celt != 1)
+            {
+                break;
+            }
+            DWORD child_tag = SymTagNull;
+            child->get_symTag(&child_tag);
+            if (child_tag != SymTagData && child_tag != SymTagBaseClass && child_tag != SymTagVTable)
+            {
+                continue;
+            }
+            DWORD location_type = LocIsNull;
+            child->get_locationType(&location_type);
+            if (child_tag == SymTagData && location_type != LocIsThisRel && location_type != LocIsBitField)
+            {
+                // static members and constants take no room in the object
+                continue;
+            }
+            CComBSTR child_name;
+            child->get_name(&child_name);
+            LONG offset = 0;
+            child->get_offset(&offset);
+            DWORD child_type = 0;
+            child->get_typeId(&child_type);
+            hash = HashCombine(hash, child_tag);
+            hash = HashCombine(hash, child_name.m_str ? HashSymbolName(child_name.m_str, child_name.Length()) : 0);
+            hash = HashCombine(hash, (uint32_t)offset);
+            if (location_type == LocIsBitField)
+            {
+                DWORD bit_position = 0;
+                ULONGLONG bit_length = 0;
+                child->get_bitPosition(&bit_position);
+                child->get_length(&bit_length);
+                hash = HashCombine(HashCombine(hash, bit_position), bit_length);
+            }
+            if (child_tag != SymTagVTable)
+            {
+                hash = HashCombine(hash, GetTypeHash(child_type));
+            }
+        }
+        break;
+    }
+    default:
+    {
+        break;
+    }
+    }
+    typeHashCache[symbolId] = hash;
+    PDBREADER_STATS_CACHE(TypeHash, Insert);
+    return hash;
+}
+
+std::optional<uint64_t> PDBReader::GetStructureHash(const std::wstring& structName)
+{
+    auto pSymbol = FindUDT(structName);
+    if (!pSymbol)
+    {
+        return {};
+    }
+    DWORD id;
+    if (FAILED(pSymbol->get_symIndexId(&id)))
+    {
+        return {};
+    }
+    return GetTypeHash(id);
+}
+
+namespace
+{
+    // everything DiffStructures() needs from one build, collected up front so builds can be compared without DIA
+    struct StructureSnapshot
+    {
+        bool found;
+        // false when some members could not be read, fields then only holds the readable ones
+        bool resolved;
+        uint64_t hash;
+        uint64_t size;
+        std::vector<PDBReader::FieldInfo> fields;
+        std::vector<uint64_t> field_type_hashes;
+    };
+}
+
+const PDBReader::FunctionSignature* PDBReader::GetFunctionSignature(DWORD symbolId)
+{
+    PDBREADER_STATS_API(GetFunctionSignature);
+    CComPtr<IDiaSymbol> sym;
+    DWORD tag;
+    if (FAILED(pSession->symbolById(symbolId, &sym)) || FAILED(sym->get_symTag(&tag)))
+    {
+        return nullptr;
+    }
+    // functions are looked up through their type, so all functions of one type share the cache entry
+    DWORD type_id = symbolId;
+    if (tag == SymTagFunction)
+    {
+        if (FAILED(sym->get_typeId(&type_id)))
+        {
+            return nullptr;
+        }
+        sym.Release();
+        if (FAILED(pSession->symbolById(type_id, &sym)) || FAILED(sym->get_symTag(&tag)))
+        {
+            return nullptr;
+        }
+    }
+    if (tag != SymTagFunctionType)
+    {
+        return nullptr;
+    }
+    auto cached = functionSignatureCache.find(type_id);
+    if (cached != functionSignatureCache.end())
+    {
+        PDBREADER_STATS_CACHE(FunctionSignature, Hit);
+        return cached->second;
+    }
+    PDBREADER_STATS_CACHE(FunctionSignature, Miss);
+
+    FunctionSignature signature = {};
+    if (FAILED(sym->get_callingConvention(&signature.calling_convention)) || FAILED(sym->get_typeId(&signature.return_type_id)))
+    {
+        return nullptr;
+    }
+    CComPtr<IDiaSymbol> class_parent;
+    if (sym->get_classParent(&class_parent) == S_OK && class_parent)
+    {
+        class_parent->get_symIndexId(&signature.class_type_id);
+    }
+    CComPtr<IDiaSymbol> this_type;
+    if (sym->get_objectPointerType(&this_type) == S_OK && this_type)
+    {
+        this_type->get_symIndexId(&signature.this_type_id);
+    }
+    CComPtr<IDiaEnumSymbols> pEnumArgs;
+    if (FAILED(sym->findChildren(SymTagFunctionArgType, 0, nsNone, &pEnumArgs)))
+    {
+        return nullptr;
+    }
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> arg;
+        ULONG celt = 1;
+        HRESULT hr = pEnumArgs->Next(1, &arg, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        DWORD arg_type_id;
+        if (FAILED(arg->get_typeId(&arg_type_id)))
+        {
+            return nullptr;
+        }
+        // "..." is an argument of base type btNoType
+        CComPtr<IDiaSymbol> arg_type;
+        DWORD arg_tag, base_type;
+        if (SUCCEEDED(pSession->symbolById(arg_type_id, &arg_type)) && SUCCEEDED(arg_type->get_symTag(&arg_tag)) && arg_tag == SymTagBaseType
+            && SUCCEEDED(arg_type->get_baseType(&base_type)) && base_type == btNoType)
+        {
+            signature.variadic = true;
+            continue;
+        }
+        signature.argument_type_ids.push_back(arg_type_id);
+    }
+
+    uint64_t hash = HashCombine(HashCombine(HashCombine(HashCombine(signature.calling_convention, signature.return_type_id),
+        signature.class_type_id), signature.this_type_id), signature.variadic);
+    for (auto arg : signature.argument_type_ids)
+    {
+        hash = HashCombine(hash, arg);
+    }
+    const FunctionSignature* shared = nullptr;
+    auto& candidates = functionSignatureIndex[hash];
+    for (auto candidate : candidates)
+    {
+        if (candidate->calling_convention == signature.calling_convention && candidate->return_type_id == signature.return_type_id
+            && candidate->class_type_id == signature.class_type_id && candidate->this_type_id == signature.this_type_id
+            && candidate->variadic == signature.variadic && candidate->argument_type_ids == signature.argument_type_ids)
+        {
+            shared = candidate;
+            break;
+        }
+    }
+    if (!shared)
+    {
+        functionSignatures.push_back(std::move(signature));
+        shared = &functionSignatures.back();
+        candidates.push_back(shared);
+    }
+    functionSignatureCache[type_id] = shared;
+    PDBREADER_STATS_CACHE(FunctionSignature, Insert);
+    return shared;
+}
+
+void PDBReader::ForEachFunctionSignature(const std::function<bool(const SymbolInfo&, const FunctionSignature*)>& callback)
+{
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagFunction, 0, nsNone, &pEnumSymbols)))
+    {
+        return;
+    }
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        SymbolInfo info = {};
+        CComBSTR tmp_name;
+        if (FAILED(pSymbol->get_symIndexId(&info.sym_index_id)) || FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str)
+        {
+            continue;
+        }
+        info.tag = SymTagFunction;
+        if (FAILED(pSymbol->get_relativeVirtualAddress(&info.rva)))
+        {
+            info.rva = 0;
+        }
+        if (FAILED(pSymbol->get_length(&info.length)))
+        {
+            info.length = 0;
+        }
+        info.name = tmp_name.m_str;
+        auto signature = GetFunctionSignature(info.sym_index_id);
+        if (signature && !callback(info, signature))
+        {
+            break;
+        }
+    }
+}
+
+const std::vector<PDBReader::VirtualSlot>& PDBReader::GetVirtualSlots(IDiaSymbol* udt, int depth)
+{
+    static const std::vector<VirtualSlot> no_slots;
+    DWORD id;
+    if (FAILED(udt->get_symIndexId(&id)))
+    {
+        return no_slots;
+    }
+    auto itr = virtualSlotCache.find(id);
+    if (itr != virtualSlotCache.end())
+    {
+        PDBREADER_STATS_CACHE(VirtualSlot, Hit);
+        return itr->second;
+    }
+    PDBREADER_STATS_CACHE(VirtualSlot, Miss);
+    // a class can't derive from itself, a chain this deep only comes from a broken pdb
+    if (depth > 64)
+    {
+        return no_slots;
+    }
+
+    std::vector<VirtualSlot> slots;
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (SUCCEEDED(udt->findChildren(SymTagEnum::SymTagBaseClass, 0, nsNone, &pEnumSymbols)))
+    {
+        for (;;)
+        {
+            CComPtr<IDiaSymbol> base;
+            ULONG celt = 1;
+            HRESULT hr = pEnumSymbols->Next(1, &base, &celt);
+            if ((FAILED(hr)) || (celt != 1))
+            {
+                break;
+            }
+            // the primary base shares the vfptr at offset 0, its slots come first
+            LONG offset = -1;
+            BOOL is_virtual = FALSE;
+            CComPtr<IDiaSymbol> base_type;
+            if (FAILED(base->get_offset(&offset)) || offset != 0 || (base->get_virtualBaseClass(&is_virtual) == S_OK && is_virtual)
+                || FAILED(base->get_type(&base_type)) || !base_type)
+            {
+                continue;
+            }
+            slots = GetVirtualSlots(base_type, depth + 1);
+            if (!slots.empty())
+            {
+                break;
+            }
+        }
+    }
+
+    CComBSTR class_name;
+    udt->get_name(&class_name);
+    DWORD pointer_size = GetPointerSize();
+    pEnumSymbols.Release();
+    if (SUCCEEDED(udt->findChildren(SymTagEnum::SymTagFunction, 0, nsNone, &pEnumSymbols)))
+    {
+        for (;;)
+        {
+            CComPtr<IDiaSymbol> function;
+            ULONG celt = 1;
+            HRESULT hr = pEnumSymbols->Next(1, &function, &celt);
+            if ((FAILED(hr)) || (celt != 1))
+            {
+                break;
+            }
+            BOOL is_virtual = FALSE;
+            DWORD vtable_offset = 0;
+            CComBSTR name;
+            if (function->get_virtual(&is_virtual) != S_OK || !is_virtual || FAILED(function->get_virtualBaseOffset(&vtable_offset))
+                || FAILED(function->get_name(&name)) || !name.m_str)
+            {
+                continue;
+            }
+            VirtualSlot slot = {};
+            slot.class_name = class_name.m_str ? class_name.m_str : L"";
+            slot.method = name.m_str;
+            BOOL pure = FALSE;
+            slot.pure = function->get_pure(&pure) == S_OK && pure;
+            if (slot.pure || function->get_relativeVirtualAddress(&slot.rva) != S_OK)
+            {
+                slot.rva = 0;
+            }
+            size_t index = vtable_offset / pointer_size;
+            BOOL intro = FALSE;
+            if (function->get_intro(&intro) != S_OK || !intro)
+            {
+                // an override replaces a slot of the primary vtable only if it overrides the method in it,
+                // otherwise the method it overrides lives in a secondary vtable
+                if (index >= slots.size() || (slots[index].method != slot.method && (slots[index].method.compare(0, 1, L"~") || slot.method.compare(0, 1, L"~"))))
+                {
+                    continue;
+                }
+            }
+            if (index >= slots.size())
+            {
+                slots.resize(index + 1);
+            }
+            slots[index] = std::move(slot);
+        }
+    }
+    auto& ret = virtualSlotCache[id] = std::move(slots);
+    PDBREADER_STATS_CACHE(VirtualSlot, Insert);
+    return ret;
+}
+
+void PDBReader::ResolveVirtualTable(VirtualTable& table)
+{
+    // secondary vftables are decorated as ??_7Class@@6BBase@@@, the class's own one has no base
+    for (auto& candidate : FindSymbolsByUndecoratedName(table.class_name + L"::`vftable'"))
+    {
+        auto& name = candidate.name;
+        if (name.size() >= 5 && name.compare(name.size() - 5, 5, L"@@6B@") == 0)
+        {
+            table.vtable_rva = candidate.rva;
+            break;
+        }
+    }
+    for (auto& slot : table.slots)
+    {
+        if (slot.rva || slot.pure || slot.method.empty())
+        {
+            continue;
+        }
+        // overloads leave the name ambiguous, the slot is left without an rva then
+        auto candidates = FindSymbolsByUndecoratedName(slot.class_name + L"::" + slot.method);
+        if (candidates.size() == 1)
+        {
+            slot.rva = candidates[0].rva;
+        }
+    }
+}
+
+std::optional<PDBReader::VirtualTable> PDBReader::GetVirtualTable(const std::wstring& className)
+{
+    PDBREADER_STATS_API(GetVirtualTable);
+    auto pSymbol = FindUDT(className);
+    if (!pSymbol)
+    {
+        return {};
+    }
+    VirtualTable table = {};
+    table.class_name = className;
+    table.slots = GetVirtualSlots(pSymbol, 0);
+    if (table.slots.empty())
+    {
+        return {};
+    }
+    ResolveVirtualTable(table);
+    return table;
+}
+
+std::vector<PDBReader::VirtualTable> PDBReader::GetVirtualTables()
+{
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagUDT, 0, nsNone, &pEnumSymbols)))
+    {
+        return {};
+    }
+    std::vector<VirtualTable> ret;
+    // a class is listed once per compiland which uses it
+    std::set<std::wstring> seen;
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        CComBSTR tmp_name;
+        ULONGLONG length = 0;
+        if (FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str || FAILED(pSymbol->get_length(&length)) || !length)
+        {
+            continue;
+        }
+        std::wstring name(tmp_name.m_str);
+        if (!seen.insert(name).second)
+        {
+            continue;
+        }
+        auto& slots = GetVirtualSlots(pSymbol, 0);
+        if (slots.empty())
+        {
+            continue;
+        }
+        VirtualTable table = {};
+        table.class_name = std::move(name);
+        table.slots = slots;
+        ResolveVirtualTable(table);
+        ret.push_back(std::move(table));
+    }
+    return ret;
+}
+
+namespace
+{
+    // entries which take bytes of their own, bases only span the entries of their members
+    bool IsLayoutLeaf(const PDBReader::LayoutEntry& entry)
+    {
+        return entry.kind == PDBReader::LayoutEntry::Kind::Field || entry.kind == PDBReader::LayoutEntry::Kind::VfPtr
+            || entry.kind == PDBReader::LayoutEntry::Kind::VbPtr;
+    }
+
+    uint32_t LayoutLeafEnd(const std::vector<PDBReader::LayoutEntry>& entries)
+    {
+        uint64_t end = 0;
+        for (auto& entry : entries)
+        {
+            if (IsLayoutLeaf(entry))
+            {
+                end = std::max(end, entry.offset + entry.size);
+            }
+        }
+        return (uint32_t)end;
+    }
+}
+
+void PDBReader::FlattenLayout(IDiaSymbol* udt, uint32_t base_offset, uint32_t depth, bool most_derived, std::vector<LayoutEntry>& out)
+{
+    // a class can't derive from itself, a chain this deep only comes from a broken pdb
+    if (depth > 64)
+    {
+        return;
+    }
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(udt->findChildren(SymTagEnum::SymTagNull, 0, nsNone, &pEnumSymbols)))
+    {
+        return;
+    }
+    CComBSTR class_name;
+    udt->get_name(&class_name);
+    std::wstring owner = class_name.m_str ? class_name.m_str : L"";
+    DWORD pointer_size = GetPointerSize();
+    // a derived class lists the vfptr or vbptr it shares with its base again
+    auto add_pointer = [&](LayoutEntry::Kind kind, uint32_t offset) {
+        for (auto& entry : out)
+        {
+            if (entry.kind == kind && entry.offset == offset)
+            {
+                return;
+            }
+        }
+        LayoutEntry entry = {};
+        entry.kind = kind;
+        entry.name = kind == LayoutEntry::Kind::VfPtr ? L"__vfptr" : L"__vbptr";
+        entry.owner = owner;
+        entry.offset = offset;
+        entry.size = pointer_size;
+        entry.depth = depth;
+        out.push_back(std::move(entry));
+    };
+    // (vbtable index, base) of the virtual bases, laid out after everything else
+    std::vector<std::pair<DWORD, CComPtr<IDiaSymbol>>> virtual_bases;
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> child;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &child, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        DWORD tag = SymTagNull;
+        child->get_symTag(&tag);
+        LONG offset = 0;
+        if (tag == SymTagVTable)
+        {
+            if (SUCCEEDED(child->get_offset(&offset)))
+            {
+                add_pointer(LayoutEntry::Kind::VfPtr, base_offset + offset);
+            }
+            continue;
+        }
+        if (tag != SymTagBaseClass && tag != SymTagData)
+        {
+            continue;
+        }
+        BOOL is_virtual = FALSE;
+        if (tag == SymTagBaseClass && child->get_virtualBaseClass(&is_virtual) == S_OK && is_virtual)
+        {
+            // the class declaring a virtual base holds the vbptr pointing to it
+            BOOL indirect = FALSE;
+            LONG vbptr_offset = 0;
+            if ((child->get_indirectVirtualBaseClass(&indirect) != S_OK || !indirect) && SUCCEEDED(child->get_virtualBasePointerOffset(&vbptr_offset)))
+            {
+                add_pointer(LayoutEntry::Kind::VbPtr, base_offset + vbptr_offset);
+            }
+            DWORD index = 0;
+            if (most_derived && SUCCEEDED(child->get_virtualBaseDispIndex(&index)))
+            {
+                virtual_bases.push_back({ index, child });
+            }
+            continue;
+        }
+        DWORD location_type = LocIsNull;
+        if (tag == SymTagData && (FAILED(child->get_locationType(&location_type)) || (location_type != LocIsThisRel && location_type != LocIsBitField)))
+        {
+            // static members and constants take no room in the object
+            continue;
+        }
+        CComBSTR name;
+        DWORD type_id = 0;
+        if (FAILED(child->get_offset(&offset)) || FAILED(child->get_name(&name)) || !name.m_str || FAILED(child->get_typeId(&type_id)))
+        {
+            continue;
+        }
+        LayoutEntry entry = {};
+        entry.kind = tag == SymTagBaseClass ? LayoutEntry::Kind::BaseClass : LayoutEntry::Kind::Field;
+        entry.name = name.m_str;
+        entry.owner = owner;
+        entry.offset = base_offset + offset;
+        entry.depth = depth;
+        entry.type = GetTypeInfo(type_id);
+        entry.size = entry.type.size;
+        if (location_type == LocIsBitField)
+        {
+            DWORD bit_position = 0;
+            ULONGLONG bit_length = 0;
+            child->get_bitPosition(&bit_position);
+            child->get_length(&bit_length);
+            entry.bit_position = bit_position;
+            entry.bit_length = (uint32_t)bit_length;
+        }
+        out.push_back(entry);
+        CComPtr<IDiaSymbol> base_type;
+        if (tag == SymTagBaseClass && SUCCEEDED(child->get_type(&base_type)) && base_type)
+        {
+            FlattenLayout(base_type, entry.offset, depth + 1, false, out);
+        }
+    }
+
+    std::sort(virtual_bases.begin(), virtual_bases.end(), [](const std::pair<DWORD, CComPtr<IDiaSymbol>>& a, const std::pair<DWORD, CComPtr<IDiaSymbol>>& b) {
+        return a.first < b.first;
+        });
+    if (virtual_bases.empty())
+    {
+        return;
+    }
+    // the non-virtual part is padded to its own alignment before the first virtual base
+    uint32_t alignment = GetTypeAlignment(udt, true);
+    uint32_t end = (LayoutLeafEnd(out) + alignment - 1) & ~(alignment - 1);
+    for (auto& virtual_base : virtual_bases)
+    {
+        auto& child = virtual_base.second;
+        CComPtr<IDiaSymbol> base_type;
+        CComBSTR name;
+        DWORD type_id = 0;
+        if (FAILED(child->get_type(&base_type)) || !base_type || FAILED(child->get_name(&name)) || !name.m_str || FAILED(child->get_typeId(&type_id)))
+        {
+            continue;
+        }
+        LayoutEntry entry = {};
+        entry.kind = LayoutEntry::Kind::VirtualBaseClass;
+        entry.name = name.m_str;
+        entry.owner = owner;
+        entry.depth = depth + 1;
+        entry.type = GetTypeInfo(type_id);
+        entry.size = entry.type.size;
+        alignment = GetTypeAlignment(base_type);
+        entry.offset = (end + alignment - 1) & ~(alignment - 1);
+        size_t first = out.size();
+        out.push_back(entry);
+        FlattenLayout(base_type, entry.offset, depth + 1, false, out);
+        for (size_t i = first; i < out.size(); i++)
+        {
+            out[i].derived_offset = true;
+        }
+        end = std::max(entry.offset, LayoutLeafEnd(out));
+    }
+}
+
+const std::vector<PDBReader::LayoutEntry> PDBReader::GetFlattenedLayout(const std::wstring& className)
+{
+    PDBREADER_STATS_API(GetFlattenedLayout);
+    auto pSymbol = FindUDT(className);
+    if (!pSymbol)
+    {
+        return {};
+    }
+    return GetFlattenedLayout(pSymbol);
+}
+
+const std::vector<PDBReader::LayoutEntry> PDBReader::GetFlattenedLayout(IDiaSymbol* pSymbol)
+{
+    DWORD id;
+    ULONGLONG length = 0;
+    if (FAILED(pSymbol->get_symIndexId(&id)) || FAILED(pSymbol->get_length(&length)))
+    {
+        return {};
+    }
+    auto itr = flattenedLayoutCache.find(id);
+    if (itr != flattenedLayoutCache.end())
+    {
+        PDBREADER_STATS_CACHE(FlattenedLayout, Hit);
+        return itr->second;
+    }
+    PDBREADER_STATS_CACHE(FlattenedLayout, Miss);
+    std::vector<LayoutEntry> entries;
+    FlattenLayout(pSymbol, 0, 0, true, entries);
+    // derived virtual base offsets are only trusted if they add up to the size the compiler gave the class
+    bool derived = std::any_of(entries.begin(), entries.end(), [](const LayoutEntry& entry) { return entry.derived_offset; });
+    uint32_t alignment = GetTypeAlignment(pSymbol);
+    bool verified = !derived || ((LayoutLeafEnd(entries) + alignment - 1) & ~(alignment - 1)) == length;
+
+    // holes between the bytes fields and pointers take, and after the last of them
+    std::vector<std::pair<uint64_t, uint64_t>> leaves;
+    for (auto& entry : entries)
+    {
+        if (IsLayoutLeaf(entry) && (verified || !entry.derived_offset))
+        {
+            leaves.push_back({ entry.offset, entry.offset + entry.size });
+        }
+    }
+    std::sort(leaves.begin(), leaves.end());
+    uint64_t covered = 0;
+    auto add_padding = [&](uint64_t end) {
+        if (end <= covered)
+        {
+            return;
+        }
+        LayoutEntry padding = {};
+        padding.kind = LayoutEntry::Kind::Padding;
+        padding.offset = (uint32_t)covered;
+        padding.size = end - covered;
+        entries.push_back(std::move(padding));
+    };
+    for (auto& leaf : leaves)
+    {
+        add_padding(leaf.first);
+        covered = std::max(covered, leaf.second);
+    }
+    if (verified)
+    {
+        add_padding(length);
+    }
+    // bases stay in front of their first member
+    std::stable_sort(entries.begin(), entries.end(), [](const LayoutEntry& a, const LayoutEntry& b) {
+        return a.offset < b.offset;
+        });
+
+    flattenedLayoutCache[id] = entries;
+    PDBREADER_STATS_CACHE(FlattenedLayout, Insert);
+    return entries;
+}
+
+std::optional<PDBReader::LayoutReport> PDBReader::AnalyzeLayout(const std::wstring& className, uint32_t cacheLineSize, const std::vector<std::wstring>& hotFields)
+{
+    PDBREADER_STATS_API(AnalyzeLayout);
+    if (!cacheLineSize)
+    {
+        throw std::exception("cache line size must not be zero");
+    }
+    auto pSymbol = FindUDT(className);
+    ULONGLONG length = 0;
+    if (!pSymbol || FAILED(pSymbol->get_length(&length)))
+    {
+        return {};
+    }
+    LayoutReport report = {};
+    report.name = className;
+    report.size = length;
+    report.cache_line_size = cacheLineSize;
+    report.layout = GetFlattenedLayout(className);
+    report.lines.resize((size_t)((length + cacheLineSize - 1) / cacheLineSize));
+    std::set<std::wstring> hot(hotFields.begin(), hotFields.end());
+    // hot fields on each line
+    std::vector<std::vector<uint32_t>> hot_lines(report.lines.size());
+
+    for (uint32_t i = 0; i < report.layout.size(); i++)
+    {
+        auto& entry = report.layout[i];
+        if (entry.kind == LayoutEntry::Kind::Padding)
+        {
+            report.holes.push_back(i);
+            report.padding_bytes += entry.size;
+            if (entry.offset + entry.size == length)
+            {
+                report.tail_padding = entry.size;
+            }
+            continue;
+        }
+        if (!IsLayoutLeaf(entry) || !entry.size)
+        {
+            continue;
+        }
+        uint64_t first_line = entry.offset / cacheLineSize;
+        uint64_t last_line = std::min<uint64_t>((entry.offset + entry.size - 1) / cacheLineSize, report.lines.size() - 1);
+        if (first_line != last_line)
+        {
+            report.line_crossings.push_back(i);
+        }
+        bool is_hot = entry.kind == LayoutEntry::Kind::Field && (hot.count(entry.name) || hot.count(entry.owner + L"::" + entry.name));
+        for (auto line = first_line; line <= last_line; line++)
+        {
+            report.lines[line].push_back(i);
+            if (is_hot)
+            {
+                hot_lines[line].push_back(i);
+            }
+        }
+    }
+
+    // a pair of fields spanning the same two lines is reported once
+    std::set<std::pair<uint32_t, uint32_t>> pairs;
+    for (auto& line : hot_lines)
+    {
+        for (size_t a = 0; a < line.size(); a++)
+        {
+            for (size_t b = a + 1; b < line.size(); b++)
+            {
+                if (pairs.insert({ line[a], line[b] }).second)
+                {
+                    report.false_sharing.push_back({ line[a], line[b] });
+                }
+            }
+        }
+    }
+    return report;
+}
+
+std::vector<PDBReader::LayoutWaste> PDBReader::RankLayoutsByWaste(const std::unordered_map<std::wstring, uint64_t>& instanceHints)
+{
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(pGlobal->findChildren(SymTagEnum::SymTagUDT, 0, nsNone, &pEnumSymbols)))
+    {
+        return {};
+    }
+    std::vector<LayoutWaste> ret;
+    // a type is listed once per compiland which uses it
+    std::set<std::wstring> seen;
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        CComBSTR tmp_name;
+        ULONGLONG length = 0;
+        if (FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str || FAILED(pSymbol->get_length(&length)) || !length)
+        {
+            continue;
+        }
+        std::wstring name(tmp_name.m_str);
+        // anonymous types share one placeholder name, their padding is counted in the layout of the type holding them
+        if (name.rfind(L"<unnamed-", 0) == 0 || name.find(L"__unnamed") != std::wstring::npos || !seen.insert(name).second)
+        {
+            continue;
+        }
+        LayoutWaste waste = {};
+        for (auto& entry : GetFlattenedLayout(pSymbol))
+        {
+            if (entry.kind == LayoutEntry::Kind::Padding)
+            {
+                waste.padding_bytes += entry.size;
+            }
+        }
+        if (!waste.padding_bytes)
+        {
+            continue;
+        }
+        auto hint = instanceHints.find(name);
+        waste.name = std::move(name);
+        waste.size = length;
+        waste.instances = hint != instanceHints.end() ? hint->second : 1;
+        waste.wasted_bytes = waste.padding_bytes * waste.instances;
+        ret.push_back(std::move(waste));
+    }
+    std::sort(ret.begin(), ret.end(), [](const LayoutWaste& a, const LayoutWaste& b) {
+        return a.wasted_bytes > b.wasted_bytes || (a.wasted_bytes == b.wasted_bytes && a.name < b.name);
+        });
+    return ret;
+}
+
+std::vector<PDBReader::StructureChange> PDBReader::DiffStructures(const std::vector<PDBReader*>& builds, const std::vector<std::wstring>& structNames, unsigned threads)
+{
+    PDBREADER_STATS_API(DiffStructures);
+    std::vector<std::vector<StructureSnapshot>> snapshots(builds.size(), std::vector<StructureSnapshot>(structNames.size()));
+    ParallelFor(builds.size(), threads, [&](size_t b) {
+        auto reader = builds[b];
+        for (size_t i = 0; i < structNames.size(); i++)
+        {
+            auto& snapshot = snapshots[b][i];
+            auto hash = reader->GetStructureHash(structNames[i]);
+            auto size = reader->FindStructSize(structNames[i]);
+            snapshot.found = hash && size;
+            if (!snapshot.found)
+            {
+                continue;
+            }
+            snapshot.hash = *hash;
+            snapshot.size = *size;
+            std::vector<std::wstring> failed;
+            auto pSymbol = reader->FindUDT(structNames[i]);
+            if (pSymbol)
+            {
+                snapshot.fields = reader->ReadStructureFields(pSymbol, failed);
+            }
+            snapshot.resolved = pSymbol && failed.empty();
+            for (auto& field : snapshot.fields)
+            {
+                snapshot.field_type_hashes.push_back(reader->GetTypeHash(field.type.associated_type_obj_id));
+            }
+        }
+        });
+
+    std::vector<std::vector<StructureChange>> changes(structNames.size());
+    ParallelFor(structNames.size(), threads, [&](size_t i) {
+        for (size_t b = 1; b < builds.size(); b++)
+        {
+            auto& before = snapshots[b - 1][i];
+            auto& after = snapshots[b][i];
+            StructureChange change = {};
+            change.struct_name = structNames[i];
+            change.old_build = b - 1;
+            change.new_build = b;
+            if (!before.found && !after.found)
+            {
+                continue;
+            }
+            if (before.found != after.found)
+            {
+                change.kind = after.found ? StructureChange::Kind::Added : StructureChange::Kind::Removed;
+                change.old_size = before.found ? before.size : 0;
+                change.new_size = after.found ? after.size : 0;
+                changes[i].push_back(change);
+                continue;
+            }
+            if (before.hash == after.hash)
+            {
+                continue;
+            }
+            if (before.size != after.size)
+            {
+                change.kind = StructureChange::Kind::Resized;
+                change.old_size = before.size;
+                change.new_size = after.size;
+                changes[i].push_back(change);
+            }
+            if (!before.resolved || !after.resolved)
+            {
+                // a partial member list would show every unreadable member as added or removed
+                change.kind = StructureChange::Kind::Unresolved;
+                change.old_size = before.size;
+                change.new_size = after.size;
+                changes[i].push_back(change);
+                continue;
+            }
+            std::unordered_map<std::wstring, size_t> old_fields;
+            for (size_t f = 0; f < before.fields.size(); f++)
+            {
+                old_fields[before.fields[f].name] = f;
+            }
+            for (size_t f = 0; f < after.fields.size(); f++)
+            {
+                auto& field = after.fields[f];
+                StructureChange member = change;
+                member.member = field.name;
+                member.new_offset = field.offset;
+                member.new_size = field.type.size;
+                auto itr = old_fields.find(field.name);
+                if (itr == old_fields.end())
+                {
+                    member.kind = StructureChange::Kind::Added;
+                    member.old_size = 0;
+                    changes[i].push_back(member);
+                    continue;
+                }
+                auto& old_field = before.fields[itr->second];
+                auto old_type_hash = before.field_type_hashes[itr->second];
+                old_fields.erase(itr);
+                member.old_offset = old_field.offset;
+                member.old_size = old_field.type.size;
+                if (old_field.offset != field.offset || old_field.bit_position != field.bit_position)
+                {
+                    member.kind = StructureChange::Kind::Moved;
+                    changes[i].push_back(member);
+                }
+                if (old_field.type.size != field.type.size || old_field.bit_length != field.bit_length)
+                {
+                    member.kind = StructureChange::Kind::Resized;
+                    changes[i].push_back(member);
+                }
+                else if (old_type_hash != after.field_type_hashes[f])
+                {
+                    member.kind = StructureChange::Kind::TypeChanged;
+                    changes[i].push_back(member);
+                }
+            }
+            // whatever is left only exists in the older build, reported in the old member order
+            for (size_t f = 0; f < before.fields.size(); f++)
+            {
+                if (old_fields.find(before.fields[f].name) == old_fields.end())
+                {
+                    continue;
+                }
+                StructureChange member = change;
+                member.kind = StructureChange::Kind::Removed;
+                member.member = before.fields[f].name;
+                member.old_offset = before.fields[f].offset;
+                member.old_size = before.fields[f].type.size;
+                member.new_size = 0;
+                changes[i].push_back(member);
+            }
+        }
+        });
+
+    std::vector<StructureChange> ret;
+    for (auto& c : changes)
+    {
+        ret.insert(ret.end(), c.begin(), c.end());
+    }
+    return ret;
+}
+
+std::optional<CompiledLayout> PDBReader::CompileLayout(const std::wstring& structName)
+{
+    auto size = FindStructSize(structName);
+    if (!size)
+    {
+        return {};
+    }
+    CompiledLayout layout;
+    layout.name = structName;
+    layout.size = (uint32_t)*size;
+    for (auto& field : GetStructureFields(structName))
+    {
+        CompiledLayout::Accessor accessor = {};
+        accessor.offset = field.offset;
+        accessor.size = field.type.size;
+        accessor.bit_position = field.bit_position;
+        accessor.bit_length = field.bit_length;
+        accessor.is_signed = field.type.type == Types::Integer || field.type.type == Types::Char;
+        layout.field_names.push_back(field.name);
+        layout.accessors.push_back(accessor);
+    }
+    return layout;
+}
+
+std::optional<ListWalker> PDBReader::CompileListWalker(const std::wstring& structName, const std::wstring& listField, const std::vector<std::wstring>& fields)
+{
+    auto layout = CompileLayout(structName);
+    if (!layout)
+    {
+        return {};
+    }
+    auto link = layout->FindField(listField);
+    if (!link)
+    {
+        return {};
+    }
+
+    ListWalker walker;
+    walker.link_offset = layout->accessors[*link].offset;
+    walker.pointer_size = GetPointerSize();
+    walker.doubly_linked = layout->accessors[*link].size >= walker.pointer_size * 2;
+    for (auto& field : fields)
+    {
+        auto handle = layout->FindField(field);
+        if (!handle)
+        {
+            return {};
+        }
+        walker.fields.push_back(*handle);
+    }
+    walker.layout = std::move(*layout);
+    return walker;
+}
+
+DWORD PDBReader::GetPointerSize()
+{
+    DWORD machine = 0;
+    pGlobal->get_machineType(&machine);
+    return machine == IMAGE_FILE_MACHINE_I386 || machine == IMAGE_FILE_MACHINE_ARMNT ? 4 : 8;
+}
+
+uint32_t PDBReader::GetTypeAlignment(IDiaSymbol* type, bool non_virtual, uint32_t depth)
+{
+    DWORD tag = SymTagNull;
+    ULONGLONG length = 0;
+    if (depth > 64 || FAILED(type->get_symTag(&tag)))
+    {
+        return 1;
+    }
+    switch (tag)
+    {
+    case SymTagBaseType:
+    case SymTagEnum:
+    case SymTagPointerType:
+        // scalars are aligned to their size, double and long long included on x86
+        if (FAILED(type->get_length(&length)) || !length || length > 16 || (length & (length - 1)))
+        {
+            return 1;
+        }
+        return (uint32_t)length;
+    case SymTagArrayType:
+    case SymTagTypedef:
+    {
+        CComPtr<IDiaSymbol> element;
+        if (FAILED(type->get_type(&element)) || !element)
+        {
+            return 1;
+        }
+        return GetTypeAlignment(element, false, depth + 1);
+    }
+    case SymTagUDT:
+        break;
+    default:
+        return 1;
+    }
+
+    DWORD id = 0;
+    if (FAILED(type->get_symIndexId(&id)))
+    {
+        return 1;
+    }
+    auto itr = typeAlignmentCache.find({ id, non_virtual });
+    if (itr != typeAlignmentCache.end())
+    {
+        PDBREADER_STATS_CACHE(TypeAlignment, Hit);
+        return itr->second;
+    }
+    PDBREADER_STATS_CACHE(TypeAlignment, Miss);
+    uint32_t alignment = 1;
+    CComBSTR name;
+    // the vector types are declared __declspec(align), which the pdb doesn't record
+    if (SUCCEEDED(type->get_name(&name)) && name.m_str)
+    {
+        std::wstring udt_name(name.m_str);
+        if (udt_name.rfind(L"__m128", 0) == 0)
+        {
+            alignment = 16;
+        }
+        else if (udt_name.rfind(L"__m256", 0) == 0)
+        {
+            alignment = 32;
+        }
+        else if (udt_name.rfind(L"__m512", 0) == 0)
+        {
+            alignment = 64;
+        }
+    }
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (SUCCEEDED(type->findChildren(SymTagEnum::SymTagNull, 0, nsNone, &pEnumSymbols)))
+    {
+        for (;;)
+        {
+            CComPtr<IDiaSymbol> child;
+            ULONG celt = 1;
+            HRESULT hr = pEnumSymbols->Next(1, &child, &celt);
+            if ((FAILED(hr)) || (celt != 1))
+            {
+                break;
+            }
+            DWORD child_tag = SymTagNull;
+            child->get_symTag(&child_tag);
+            if (child_tag == SymTagVTable)
+            {
+                alignment = std::max<uint32_t>(alignment, GetPointerSize());
+                continue;
+            }
+            if (child_tag == SymTagData)
+            {
+                DWORD location_type = LocIsNull;
+                if (FAILED(child->get_locationType(&location_type)) || (location_type != LocIsThisRel && location_type != LocIsBitField))
+                {
+                    continue;
+                }
+            }
+            else if (child_tag != SymTagBaseClass)
+            {
+                continue;
+            }
+            CComPtr<IDiaSymbol> child_type;
+            if (FAILED(child->get_type(&child_type)) || !child_type)
+            {
+                continue;
+            }
+            BOOL is_virtual = FALSE;
+            if (child_tag == SymTagBaseClass && child->get_virtualBaseClass(&is_virtual) == S_OK && is_virtual)
+            {
+                // reached through a vbptr, which the class or one of its bases holds
+                alignment = std::max<uint32_t>(alignment, GetPointerSize());
+                if (!non_virtual)
+                {
+                    alignment = std::max(alignment, GetTypeAlignment(child_type, false, depth + 1));
+                }
+                continue;
+            }
+            alignment = std::max(alignment, GetTypeAlignment(child_type, child_tag == SymTagBaseClass, depth + 1));
+        }
+    }
+    typeAlignmentCache[{ id, non_virtual }] = alignment;
+    PDBREADER_STATS_CACHE(TypeAlignment, Insert);
+    return alignment;
+}
+
+bool PDBReader::GetGuidAndAge(GUID& guid, DWORD& age)
+{
+    if (FAILED(pGlobal->get_guid(&guid)))
+    {
+        return false;
+    }
+    if (FAILED(pGlobal->get_age(&age)))
+    {
+        return false;
+    }
+    return true;
+}
+
+bool PDBReader::ReadDebugStream(const std::wstring& name, std::vector<BYTE>& data, DWORD* rva)
+{
+    CComPtr<IDiaEnumDebugStreams> pEnumStreams;
+    if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams)))
+    {
+        return false;
+    }
+    for (;;)
+    {
+        CComPtr<IDiaEnumDebugStreamData> pStream;
+        ULONG celt = 1;
+        HRESULT hr = pEnumStreams->Next(1, &pStream, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            return false;
+        }
+        CComBSTR stream_name;
+        if (FAILED(pStream->get_name(&stream_name)) || !stream_name.m_str || name != stream_name.m_str)
+        {
+            continue;
+        }
+        if (rva)
+        {
+            CComPtr<IDiaImageData> pImageData;
+            if (FAILED(pStream->QueryInterface(IID_IDiaImageData, (void**)&pImageData)) || FAILED(pImageData->get_relativeVirtualAddress(rva)))
+            {
+                return false;
+            }
+        }
+        data.clear();
+        for (;;)
+        {
+            // a null buffer only asks for the size of the next record
+            // some streams report no fetched count for it, an empty record is what ends the stream
+            DWORD bytes = 0;
+            ULONG fetched = 0;
+            if (FAILED(pStream->Next(1, 0, &bytes, NULL, &fetched)) || bytes == 0)
+            {
+                break;
+            }
+            size_t used = data.size();
+            data.resize(used + bytes);
+            if (FAILED(pStream->Next(1, bytes, &bytes, data.data() + used, &fetched)))
+            {
+                data.resize(used);
+                break;
+            }
+        }
+        return true;
+    }
+}
+
+void PDBReader::LoadDebugStreams()
+{
+    if (debugStreamsLoaded)
+    {
+        return;
+    }
+    debugStreamsLoaded = true;
+    std::vector<BYTE> data;
+    // images rearranged after linking keep the section headers the compiler's addresses refer to as well
+    for (auto headers : { &sections, &originalSections })
+    {
+        if (!ReadDebugStream(headers == &sections ? L"SECTIONHEADERS" : L"SECTIONHEADERSORIG", data, nullptr))
+        {
+            continue;
+        }
+        for (size_t pos = 0; pos + sizeof(IMAGE_SECTION_HEADER) <= data.size(); pos += sizeof(IMAGE_SECTION_HEADER))
+        {
+            IMAGE_SECTION_HEADER header;
+            memcpy(&header, data.data() + pos, sizeof(header));
+            SectionInfo info = {};
+            info.name.assign((const char*)header.Name, strnlen((const char*)header.Name, IMAGE_SIZEOF_SHORT_NAME));
+            info.virtual_address = header.VirtualAddress;
+            info.virtual_size = header.Misc.VirtualSize;
+            info.characteristics = header.Characteristics;
+            headers->push_back(info);
+        }
+    }
+    for (auto omap : { &omapTo, &omapFrom })
+    {
+        if (!ReadDebugStream(omap == &omapTo ? L"OMAPTO" : L"OMAPFROM", data, nullptr))
+        {
+            continue;
+        }
+        for (size_t pos = 0; pos + sizeof(DWORD) * 2 <= data.size(); pos += sizeof(DWORD) * 2)
+        {
+            DWORD entry[2];
+            memcpy(entry, data.data() + pos, sizeof(entry));
+            omap->push_back({ entry[0], entry[1] });
+        }
+        // the linker writes them sorted, don't rely on it
+        std::sort(omap->begin(), omap->end());
+    }
+}
+
+std::optional<X64Unwinder> PDBReader::CreateX64Unwinder()
+{
+    DWORD machine = 0;
+    if (FAILED(pGlobal->get_machineType(&machine)) || machine != IMAGE_FILE_MACHINE_AMD64)
+    {
+        return {};
+    }
+    std::vector<BYTE> pdata;
+    std::vector<BYTE> xdata;
+    DWORD xdata_rva = 0;
+    if (!ReadDebugStream(L"PDATA", pdata, nullptr) || !ReadDebugStream(L"XDATA", xdata, &xdata_rva))
+    {
+        return {};
+    }
+    std::vector<X64Unwinder::RuntimeFunction> functions(pdata.size() / sizeof(X64Unwinder::RuntimeFunction));
+    memcpy(functions.data(), pdata.data(), functions.size() * sizeof(X64Unwinder::RuntimeFunction));
+    return X64Unwinder(std::move(functions), std::move(xdata), xdata_rva);
+}
+
+std::vector<PDBReader::SectionInfo> PDBReader::GetSections()
+{
+    LoadDebugStreams();
+    return sections;
+}
+
+std::optional<DWORD> PDBReader::SectionOffsetToRVA(DWORD section, DWORD offset)
+{
+    LoadDebugStreams();
+    if (omapFrom.empty())
+    {
+        if (section == 0 || section > sections.size())
+        {
+            return {};
+        }
+        return sections[section - 1].virtual_address + offset;
+    }
+    // symbol records describe the original layout, which only the original headers and OMAPFROM map to the image
+    if (section == 0 || section > originalSections.size())
+    {
+        return {};
+    }
+    return TranslateRVA(originalSections[section - 1].virtual_address + offset, OmapDirection::ToImage);
+}
+
+bool PDBReader::HasOmap()
+{
+    LoadDebugStreams();
+    return !omapTo.empty() || !omapFrom.empty();
+}
+
+std::optional<DWORD> PDBReader::TranslateRVA(DWORD rva, OmapDirection direction)
 {
-    if (symbolTypeInfoCache.find(symbolId) != symbolTypeInfoCache.end())
+    LoadDebugStreams();
+    auto& omap = direction == OmapDirection::ToImage ? omapFrom : omapTo;
+    if (omap.empty())
     {
-        return symbolTypeInfoCache[symbolId];
+        return rva;
     }
-    CComPtr<IDiaSymbol> sym;
-    if (FAILED(pSession->symbolById(symbolId, &sym)))
+    // last entry starting at or below rva
+    auto it = std::upper_bound(omap.begin(), omap.end(), std::make_pair(rva, (DWORD)0xffffffff));
+    if (it == omap.begin())
     {
         return {};
     }
-    DWORD tag;
-    if (FAILED(sym->get_symTag(&tag)))
+    --it;
+    if (!it->second)
     {
         return {};
     }
-    ULONGLONG size;
-    if (FAILED(sym->get_length(&size)) || !size)
+    return it->second + (rva - it->first);
+}
+
+std::vector<DWORD> PDBReader::TranslateRVAs(const std::vector<DWORD>& rvas, OmapDirection direction)
+{
+    LoadDebugStreams();
+    auto& omap = direction == OmapDirection::ToImage ? omapFrom : omapTo;
+    if (omap.empty())
     {
-        return {};
+        return rvas;
     }
-    DWORD id;
-    if (FAILED(sym->get_symIndexId(&id)))
+    // visit the addresses in ascending order, so the table is walked once instead of searched per address
+    std::vector<uint32_t> order(rvas.size());
+    for (uint32_t i = 0; i < order.size(); i++)
     {
-        return {};
+        order[i] = i;
     }
-    TypeInfo ret = {};
-    ret.attached_pdb = this;
-    ret.size = size;
-    ret.type = Types::Unknown;
-    ret.freindly_name = L"unknown";
-    ret.associated_type_obj_id = id;
-    switch (tag)
-    {
-    case SymTagUDT:
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rvas[a] < rvas[b]; });
+
+    std::vector<DWORD> ret(rvas.size(), 0);
+    size_t entry = 0;
+    for (auto i : order)
     {
-        ret.type = Types::Class;
-        BSTR struct_name;
-        if (FAILED(sym->get_name(&struct_name)))
+        DWORD rva = rvas[i];
+        while (entry < omap.size() && omap[entry].first <= rva)
         {
-            return {};
+            entry++;
         }
-        ret.freindly_name = struct_name;
-        SysFreeString(struct_name);
-        break;
-    }
-    case SymTagArrayType:
-    {
-        ret.type = Types::Array;
-        DWORD array_element_id;
-        if (FAILED(sym->get_typeId(&array_element_id)))
+        // omap[entry - 1] is the last entry starting at or below rva
+        if (entry && omap[entry - 1].second)
         {
-            return {};
+            ret[i] = omap[entry - 1].second + (rva - omap[entry - 1].first);
         }
-        ret.arr_element_type_id = array_element_id;
-        auto element_type = GetTypeInfo(array_element_id);
-        if (!element_type.size)
+    }
+    return ret;
+}
+
+// turns a symbol name into something usable as a c++ identifier
+static std::string SanitizeIdentifier(const std::wstring& name)
+{
+    std::string ret;
+    for (auto c : name)
+    {
+        bool valid = (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'_';
+        ret.push_back(valid ? (char)c : '_');
+    }
+    if (ret.empty() || (ret[0] >= '0' && ret[0] <= '9'))
+    {
+        ret.insert(ret.begin(), '_');
+    }
+    return ret;
+}
+
+// SanitizeIdentifier(), with a numeric suffix if the result is already taken
+static std::string UniqueIdentifier(const std::wstring& name, std::set<std::string>& used)
+{
+    auto base = SanitizeIdentifier(name);
+    auto ret = base;
+    for (int i = 2; !used.insert(ret).second; i++)
+    {
+        ret = base + "_" + std::to_string(i);
+    }
+    return ret;
+}
+
+static std::string ToHex(uint64_t value)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)value);
+    return buf;
+}
+
+void PDBReader::GenerateOffsetHeader(const std::vector<std::wstring>& structNames, const std::wstring& out_file)
+{
+    GUID guid;
+    DWORD age;
+    if (!GetGuidAndAge(guid, age))
+    {
+        throw std::exception("cannot get guid and age of pdb");
+    }
+    char build[64];
+    snprintf(build, sizeof(build), "build_%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X_%u", (unsigned)guid.Data1, guid.Data2, guid.Data3,
+        guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7], (unsigned)age);
+
+    std::ofstream out;
+    out.open(out_file, std::ofstream::binary);
+    if (!out.is_open())
+    {
+        throw std::exception("cannot create file for output");
+    }
+    out << "// generated by PDBReader, do not edit\n";
+    out << "#pragma once\n#include <cstdint>\n#include <cstddef>\n\n";
+    out << "namespace pdb_offsets::" << build << "\n{\n";
+    std::vector<std::wstring> missing;
+    std::vector<std::wstring> unresolved;
+    std::set<std::wstring> seen;
+    // names like A<1> and A_1_ sanitize to the same identifier
+    std::set<std::string> namespaces;
+    for (auto& struct_name : structNames)
+    {
+        if (!seen.insert(struct_name).second)
         {
-            return {};
+            continue;
         }
-        if ((ret.size % element_type.size) != 0)
+        auto pSymbol = FindUDT(struct_name);
+        ULONGLONG length = 0;
+        if (!pSymbol || FAILED(pSymbol->get_length(&length)))
         {
-            return {};
+            missing.push_back(struct_name);
+            continue;
         }
-        ret.arr_dim = ret.size / element_type.size;
-        ret.freindly_name = std::wstring(element_type.freindly_name) + L"[" + std::to_wstring(ret.arr_dim) + L"]";
-        break;
-    }
-    case SymTagBaseType:
-    {
-        DWORD base_type;
-        if (FAILED(sym->get_baseType(&base_type)))
+        auto size = length;
+        std::vector<std::wstring> failed;
+        auto fields = ReadStructureFields(pSymbol, failed);
+        for (auto& member : failed)
         {
-            break;
+            unresolved.push_back(struct_name + L"::" + member);
         }
-        if (base_type == btChar || base_type == btChar8)
+        auto ns = UniqueIdentifier(struct_name, namespaces);
+        // one nested namespace per kind of value, so field names can't collide with each other or with struct_size
+        std::ostringstream offsets, sizes, bit_positions, bit_lengths, masks, checks;
+        std::set<std::string> field_names;
+        std::vector<std::string> identifiers;
+        for (auto& field : fields)
         {
-            ret.type = Types::Char;
-            ret.freindly_name = L"char";
-            break;
+            auto name = UniqueIdentifier(field.name, field_names);
+            identifiers.push_back(name);
+            offsets << "            constexpr uint32_t " << name << " = " << ToHex(field.offset) << ";\n";
+            sizes << "            constexpr uint32_t " << name << " = " << ToHex(field.type.size) << ";\n";
+            checks << "        static_assert(offset::" << name << " + size::" << name << " <= struct_size);\n";
+            if (field.bit_length)
+            {
+                uint64_t mask = (field.bit_length >= 64 ? ~0ull : ((1ull << field.bit_length) - 1)) << field.bit_position;
+                bit_positions << "            constexpr uint32_t " << name << " = " << field.bit_position << ";\n";
+                bit_lengths << "            constexpr uint32_t " << name << " = " << field.bit_length << ";\n";
+                masks << "            constexpr uint64_t " << name << " = " << ToHex(mask) << ";\n";
+            }
         }
-        else if (base_type == btWChar || base_type == btChar16)
+        out << "    namespace " << ns << "\n    {\n";
+        out << "        constexpr uint32_t struct_size = " << ToHex(size) << ";\n";
+        out << "        namespace offset\n        {\n" << offsets.str() << "        }\n";
+        out << "        namespace size\n        {\n" << sizes.str() << "        }\n";
+        out << "        namespace bit_position\n        {\n" << bit_positions.str() << "        }\n";
+        out << "        namespace bit_length\n        {\n" << bit_lengths.str() << "        }\n";
+        out << "        namespace mask\n        {\n" << masks.str() << "        }\n";
+        out << checks.str();
+        out << "    }\n";
+        // only checkable where the real definition is visible, e.g. when building against the matching sdk headers
+        out << "#ifdef PDB_OFFSETS_CHECK_LAYOUT\n";
+        out << "    static_assert(sizeof(::" << wstring2stringbytruncation(struct_name) << ") == " << ns << "::struct_size);\n";
+        for (size_t i = 0; i < fields.size(); i++)
         {
-            ret.type = Types::Widechar;
-            ret.freindly_name = L"wchar";
-            break;
+            if (fields[i].bit_length)
+            {
+                continue;
+            }
+            out << "    static_assert(offsetof(::" << wstring2stringbytruncation(struct_name) << ", " << wstring2stringbytruncation(fields[i].name) << ") == "
+                << ns << "::offset::" << identifiers[i] << ");\n";
         }
-        else if (base_type == btInt || base_type == btLong)
+        out << "#endif\n";
+    }
+    out << "}\n";
+    for (auto& struct_name : missing)
+    {
+        out << "// not found: " << wstring2stringbytruncation(struct_name) << "\n";
+    }
+    for (auto& member : unresolved)
+    {
+        out << "// member not resolved: " << wstring2stringbytruncation(member) << "\n";
+    }
+}
+
+std::vector<std::wstring> PDBReader::BuildOffsetDatabase(const std::vector<std::wstring>& pdbs, const std::vector<OffsetDatabase::Query>& queries,
+    const std::wstring& out_file, unsigned threads)
+{
+    std::vector<std::optional<OffsetDatabase::BuildLayout>> layouts(pdbs.size());
+    ParallelFor(pdbs.size(), threads, [&](size_t i) {
+        try
         {
-            ret.type = Types::Integer;
-            ret.freindly_name = L"int" + std::to_wstring(ret.size * 8);
-            break;
+            PDBReader reader(pdbs[i]);
+            OffsetDatabase::BuildLayout layout = {};
+            if (!reader.GetGuidAndAge(layout.guid, layout.age))
+            {
+                return;
+            }
+            layout.values.reserve(queries.size());
+            for (auto& query : queries)
+            {
+                std::optional<uint64_t> value;
+                if (query.kind == OffsetDatabase::Query::Kind::StructMemberOffset)
+                {
+                    // fields are cached per structure, so each structure is enumerated once per pdb
+                    for (auto& field : reader.GetStructureFields(query.name))
+                    {
+                        if (field.name == query.member)
+                        {
+                            value = field.offset;
+                            break;
+                        }
+                    }
+                }
+                else if (query.kind == OffsetDatabase::Query::Kind::StructSize)
+                {
+                    value = reader.FindStructSize(query.name);
+                }
+                else
+                {
+                    DWORD type;
+                    value = reader.FindSymbol(query.name, type);
+                }
+                layout.values.push_back(value && *value < OffsetDatabase::not_found ? (uint32_t)*value : OffsetDatabase::not_found);
+            }
+            layouts[i] = std::move(layout);
         }
-        else if (base_type == btUInt || base_type == btULong)
+        catch (std::exception&)
         {
-            ret.type = Types::UInteger;
-            ret.freindly_name = L"uint" + std::to_wstring(ret.size * 8);
-            break;
+            // reported through the returned list
         }
-        else if (base_type == btFloat && ret.size == 4)
+        });
+
+    std::vector<OffsetDatabase::BuildLayout> builds;
+    std::vector<std::wstring> failed;
+    for (size_t i = 0; i < pdbs.size(); i++)
+    {
+        if (layouts[i])
         {
-            ret.type = Types::Float;
-            ret.freindly_name = L"float";
-            break;
+            builds.push_back(std::move(*layouts[i]));
         }
-        else if (base_type == btFloat && ret.size == 8)
+        else
         {
-            ret.type = Types::Double;
-            ret.freindly_name = L"double";
-            break;
+            failed.push_back(pdbs[i]);
         }
-        break;
-    }
-    default:
-    {
-        break;
     }
-    }
-    symbolTypeInfoCache[symbolId] = ret;
-    return ret;
+    OffsetDatabase::Write(queries, builds, out_file);
+    return failed;
 }
 
 void PDBReader::DownloadPDBForFile(std::wstring executable_name, std::wstring symbol_folder, std::wstring SYMBOL_SERVER_URL)
@@ -500,39 +3326,65 @@ void PDBReader::DownloadPDBForFile(std::wstring executable_name, std::wstring sy
 
 HRESULT PDBReader::CreateDiaDataSourceWithoutComRegistration(IDiaDataSource** data_source)
 {
-    HMODULE hmodule = LoadLibraryW(PDBReader::dia_dll_name.c_str());
-    // try to load dia dll using the full name
-    if (!hmodule && dia_dll_full_path != L"")
-    {
-        hmodule = LoadLibraryW(dia_dll_full_path.c_str());
-    }
-    if (!hmodule)
-    {
-        return HRESULT_FROM_WIN32(GetLastError());
-    }
-    HRESULT(WINAPI * DllGetClassObject)(REFCLSID, REFIID, LPVOID*) = (HRESULT(WINAPI*)(REFCLSID, REFIID, LPVOID*))GetProcAddress(hmodule, "DllGetClassObject");
-    if (!DllGetClassObject)
+    IClassFactory* pClassFactory = NULL;
     {
-        return E_FAIL;
+        std::lock_guard<std::mutex> lock(dia_factory_lock);
+        if (!dia_class_factory)
+        {
+            HMODULE hmodule = dia_module;
+            if (!hmodule)
+            {
+                hmodule = LoadLibraryW(PDBReader::dia_dll_name.c_str());
+            }
+            // try to load dia dll using the full name
+            if (!hmodule && dia_dll_full_path != L"")
+            {
+                hmodule = LoadLibraryW(dia_dll_full_path.c_str());
+            }
+            if (!hmodule)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+            dia_module = hmodule;
+            HRESULT(WINAPI * DllGetClassObject)(REFCLSID, REFIID, LPVOID*) = (HRESULT(WINAPI*)(REFCLSID, REFIID, LPVOID*))GetProcAddress(hmodule, "DllGetClassObject");
+            if (!DllGetClassObject)
+            {
+                return E_FAIL;
+            }
+            HRESULT hr = DllGetClassObject(CLSID_DiaSource, IID_IClassFactory, (LPVOID*)&dia_class_factory);
+            if (FAILED(hr))
+            {
+                dia_class_factory = NULL;
+                return hr;
+            }
+        }
+        // the cached reference is never released, as msdia dll is never unloaded either
+        pClassFactory = dia_class_factory;
+        pClassFactory->AddRef();
     }
-    IClassFactory* pClassFactory = NULL;
-    HRESULT hr = DllGetClassObject(CLSID_DiaSource, IID_IClassFactory, (LPVOID*)&pClassFactory);
-    if (FAILED(hr))
+    HRESULT hr = pClassFactory->CreateInstance(NULL, IID_IDiaDataSource, (void**)data_source);
+    pClassFactory->Release();
+    return hr;
+}
+
+CComPtr<IDiaSymbol> PDBReader::FindUDT(const std::wstring& structName)
+{
+    auto best = FindBestSymbol(structName, SymTagEnum::SymTagUDT);
+    if (!best || !best->length)
     {
-        return hr;
+        return {};
     }
-    hr = pClassFactory->CreateInstance(NULL, IID_IDiaDataSource, (void**)data_source);
-    if (FAILED(hr))
+    CComPtr<IDiaSymbol> pSymbol;
+    if (FAILED(pSession->symbolById(best->sym_index_id, &pSymbol)))
     {
-        pClassFactory->Release();
-        return hr;
+        return {};
     }
-    pClassFactory->Release();
-    return S_OK;
+    return pSymbol;
 }
 
 const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(IDiaSymbol* sym)
 {
+    PDBREADER_STATS_API(GetStructureFields);
     DWORD id;
     if (FAILED(sym->get_symIndexId(&id)))
     {
@@ -540,8 +3392,10 @@ const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(IDiaSymbol
     }
     if (structureFieldInfoCache.find(id) != structureFieldInfoCache.end())
     {
+        PDBREADER_STATS_CACHE(StructureFieldInfo, Hit);
         return structureFieldInfoCache[id];
     }
+    PDBREADER_STATS_CACHE(StructureFieldInfo, Miss);
     CComPtr<IDiaEnumSymbols> pEnumSymbols;
     if (FAILED(sym->findChildrenEx(SymTagEnum::SymTagNull, 0, nsfCaseSensitive, &pEnumSymbols)))
     {
@@ -585,6 +3439,18 @@ const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(IDiaSymbol
             return {};
         }
         info.offset = offset;
+        DWORD location_type;
+        if (SUCCEEDED(field->get_locationType(&location_type)) && location_type == LocIsBitField)
+        {
+            DWORD bit_position;
+            ULONGLONG bit_length;
+            if (FAILED(field->get_bitPosition(&bit_position)) || FAILED(field->get_length(&bit_length)))
+            {
+                return {};
+            }
+            info.bit_position = bit_position;
+            info.bit_length = (uint32_t)bit_length;
+        }
         DWORD type_obj_id;
         if (FAILED(field->get_typeId(&type_obj_id)))
         {
@@ -599,11 +3465,70 @@ const std::vector<PDBReader::FieldInfo> PDBReader::GetStructureFields(IDiaSymbol
         ret.push_back(info);
     }
     structureFieldInfoCache[id] = ret;
+    PDBREADER_STATS_CACHE(StructureFieldInfo, Insert);
+    return ret;
+}
+
+std::vector<PDBReader::FieldInfo> PDBReader::ReadStructureFields(IDiaSymbol* sym, std::vector<std::wstring>& failed)
+{
+    std::vector<FieldInfo> ret;
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    if (FAILED(sym->findChildren(SymTagEnum::SymTagData, 0, nsNone, &pEnumSymbols)))
+    {
+        failed.push_back(L"*");
+        return ret;
+    }
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> field;
+        ULONG celt = 1;
+        HRESULT hr = pEnumSymbols->Next(1, &field, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        DWORD location_type = LocIsNull;
+        if (FAILED(field->get_locationType(&location_type)) || (location_type != LocIsThisRel && location_type != LocIsBitField))
+        {
+            // static members and constants take no room in the object
+            continue;
+        }
+        FieldInfo info = {};
+        CComBSTR field_name;
+        if (SUCCEEDED(field->get_name(&field_name)) && field_name.m_str)
+        {
+            info.name = field_name.m_str;
+        }
+        LONG offset = 0;
+        DWORD type_obj_id = 0;
+        if (FAILED(field->get_offset(&offset)) || FAILED(field->get_typeId(&type_obj_id)))
+        {
+            failed.push_back(info.name);
+            continue;
+        }
+        info.offset = offset;
+        if (location_type == LocIsBitField)
+        {
+            DWORD bit_position = 0;
+            ULONGLONG bit_length = 0;
+            if (FAILED(field->get_bitPosition(&bit_position)) || FAILED(field->get_length(&bit_length)))
+            {
+                failed.push_back(info.name);
+                continue;
+            }
+            info.bit_position = bit_position;
+            info.bit_length = (uint32_t)bit_length;
+        }
+        // types without a size (arrays without a bound) still have an offset, type.size is 0 for them
+        info.type = GetTypeInfo(type_obj_id);
+        ret.push_back(std::move(info));
+    }
     return ret;
 }
 
 void PDBReader::BuildSortedFunctionRVANameList()
 {
+    PDBREADER_STATS_INDEX_BUILD(SortedFunctionRVANameList);
     CComPtr<IDiaEnumSymbols> pEnumSymbols;
     HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagFunction, 0, nsfCaseSensitive, &pEnumSymbols);
     if (FAILED(hr))
@@ -644,7 +3569,199 @@ void PDBReader::BuildSortedFunctionRVANameList()
         SortedFunctionRVANameList.push_back(std::make_tuple((uint32_t)function_rva, func_name));
     }
 
-    SortedFunctionRVANameList.sort([](const std::tuple<uint32_t, std::wstring>& p1, const std::tuple<uint32_t, std::wstring>& p2) -> bool {
+    std::sort(SortedFunctionRVANameList.begin(), SortedFunctionRVANameList.end(), [](const std::tuple<uint32_t, std::wstring>& p1, const std::tuple<uint32_t, std::wstring>& p2) -> bool {
         return std::get<0>(p1) < std::get<0>(p2);
-        });;
+        });
+}
+
+std::string PDBReader::ExportStatsJson()
+{
+#ifdef PDBREADER_ENABLE_STATS
+    auto snapshot = TakeSnapshot();
+    std::ostringstream out;
+    out << "{\n  \"apis\": {";
+    for (int i = 0; i < ApiCount; i++)
+    {
+        auto calls = snapshot->api_calls[i];
+        out << (i ? ",\n" : "\n") << "    \"" << api_names[i] << "\": {\"calls\": " << calls
+            << ", \"total_ns\": " << snapshot->api_total_ns[i]
+            << ", \"p50_ns\": " << LatencyPercentile(snapshot->api_latency[i], calls, 0.5)
+            << ", \"p99_ns\": " << LatencyPercentile(snapshot->api_latency[i], calls, 0.99)
+            << ", \"histogram\": [";
+        bool first = true;
+        for (int b = 0; b < latency_bucket_count; b++)
+        {
+            if (!snapshot->api_latency[i][b])
+            {
+                continue;
+            }
+            out << (first ? "" : ", ") << "[" << LatencyBucketUpperBound(b) << ", " << snapshot->api_latency[i][b] << "]";
+            first = false;
+        }
+        out << "]}";
+    }
+    out << "\n  },\n  \"caches\": {";
+    for (int i = 0; i < CacheCount; i++)
+    {
+        auto hit = snapshot->cache_events[i][CacheHit];
+        auto miss = snapshot->cache_events[i][CacheMiss];
+        out << (i ? ",\n" : "\n") << "    \"" << cache_names[i] << "\": {";
+        for (int e = 0; e < CacheEventCount; e++)
+        {
+            out << "\"" << cache_event_names[e] << "\": " << snapshot->cache_events[i][e] << ", ";
+        }
+        out << "\"hit_rate\": " << (hit + miss ? (double)hit / (hit + miss) : 0.0) << "}";
+    }
+    out << "\n  },\n  \"index_builds\": {";
+    for (int i = 0; i < IndexCount; i++)
+    {
+        out << (i ? ",\n" : "\n") << "    \"" << index_names[i] << "\": {\"count\": " << snapshot->index_builds[i]
+            << ", \"total_ns\": " << snapshot->index_build_ns[i] << "}";
+    }
+    out << "\n  },\n  \"bytes_mapped\": " << snapshot->bytes_mapped << "\n}\n";
+    return out.str();
+#else
+    return "{}\n";
+#endif
+}
+
+std::string PDBReader::ExportStatsPrometheus()
+{
+#ifdef PDBREADER_ENABLE_STATS
+    auto snapshot = TakeSnapshot();
+    std::ostringstream out;
+    out << "# TYPE pdbreader_api_latency_ns histogram\n";
+    for (int i = 0; i < ApiCount; i++)
+    {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < latency_bucket_count; b++)
+        {
+            if (!snapshot->api_latency[i][b])
+            {
+                continue;
+            }
+            cumulative += snapshot->api_latency[i][b];
+            out << "pdbreader_api_latency_ns_bucket{api=\"" << api_names[i] << "\",le=\"" << LatencyBucketUpperBound(b) << "\"} " << cumulative << "\n";
+        }
+        out << "pdbreader_api_latency_ns_bucket{api=\"" << api_names[i] << "\",le=\"+Inf\"} " << snapshot->api_calls[i] << "\n";
+        out << "pdbreader_api_latency_ns_sum{api=\"" << api_names[i] << "\"} " << snapshot->api_total_ns[i] << "\n";
+        out << "pdbreader_api_latency_ns_count{api=\"" << api_names[i] << "\"} " << snapshot->api_calls[i] << "\n";
+    }
+    out << "# TYPE pdbreader_cache_events_total counter\n";
+    for (int i = 0; i < CacheCount; i++)
+    {
+        for (int e = 0; e < CacheEventCount; e++)
+        {
+            out << "pdbreader_cache_events_total{cache=\"" << cache_names[i] << "\",event=\"" << cache_event_names[e] << "\"} "
+                << snapshot->cache_events[i][e] << "\n";
+        }
+    }
+    out << "# TYPE pdbreader_index_builds_total counter\n";
+    for (int i = 0; i < IndexCount; i++)
+    {
+        out << "pdbreader_index_builds_total{index=\"" << index_names[i] << "\"} " << snapshot->index_builds[i] << "\n";
+    }
+    out << "# TYPE pdbreader_index_build_ns_total counter\n";
+    for (int i = 0; i < IndexCount; i++)
+    {
+        out << "pdbreader_index_build_ns_total{index=\"" << index_names[i] << "\"} " << snapshot->index_build_ns[i] << "\n";
+    }
+    out << "# TYPE pdbreader_bytes_mapped_total counter\n";
+    out << "pdbreader_bytes_mapped_total " << snapshot->bytes_mapped << "\n";
+    return out.str();
+#else
+    return "";
+#endif
+}
+
+void PDBReader::BuildSortedSymbolNameIndex()
+{
+    PDBREADER_STATS_INDEX_BUILD(SortedSymbolNameIndex);
+    CComPtr<IDiaEnumSymbols> pEnumSymbols;
+    HRESULT hr = pGlobal->findChildren(SymTagEnum::SymTagNull, 0, nsNone, &pEnumSymbols);
+    if (FAILED(hr))
+    {
+        throw std::exception("findChildren() with null name failed.");
+    }
+    LONG count = 0;
+    hr = pEnumSymbols->get_Count(&count);
+    if (count == 0 || (FAILED(hr)))
+    {
+        throw std::exception("get_Count() failed or returned zero");
+    }
+    std::vector<SymbolInfo> index;
+    index.reserve(count);
+    for (;;)
+    {
+        CComPtr<IDiaSymbol> pSymbol;
+        ULONG celt = 1;
+        hr = pEnumSymbols->Next(1, &pSymbol, &celt);
+        if ((FAILED(hr)) || (celt != 1))
+        {
+            break;
+        }
+        SymbolInfo info = {};
+        CComBSTR tmp_name;
+        if (FAILED(pSymbol->get_name(&tmp_name)) || !tmp_name.m_str)
+        {
+            continue;
+        }
+        if (FAILED(pSymbol->get_symIndexId(&info.sym_index_id)) || FAILED(pSymbol->get_symTag(&info.tag)))
+        {
+            continue;
+        }
+        if (FAILED(pSymbol->get_relativeVirtualAddress(&info.rva)))
+        {
+            info.rva = 0;
+        }
+        if (FAILED(pSymbol->get_length(&info.length)))
+        {
+            info.length = 0;
+        }
+        info.name = tmp_name.m_str;
+        index.push_back(std::move(info));
+    }
+    std::sort(index.begin(), index.end(), [](const SymbolInfo& a, const SymbolInfo& b) {
+        return a.name < b.name;
+        });
+    SortedSymbolNameIndex = std::move(index);
+}
+
+void PDBReader::BuildAlternateNameIndexes()
+{
+    if (SortedSymbolNameIndex.empty())
+    {
+        BuildSortedSymbolNameIndex();
+    }
+    PDBREADER_STATS_INDEX_BUILD(AlternateNameIndexes);
+    caseFoldedNameIndex.clear();
+    undecoratedNameIndex.clear();
+    caseFoldedNameIndex.reserve(SortedSymbolNameIndex.size());
+    for (uint32_t pos = 0; pos < SortedSymbolNameIndex.size(); pos++)
+    {
+        auto& info = SortedSymbolNameIndex[pos];
+        caseFoldedNameIndex[FoldCase(info.name)].push_back(pos);
+        // only publics carry decorated names
+        if (info.tag != SymTagPublicSymbol)
+        {
+            continue;
+        }
+        CComPtr<IDiaSymbol> pSymbol;
+        if (FAILED(pSession->symbolById(info.sym_index_id, &pSymbol)))
+        {
+            continue;
+        }
+        CComBSTR undecorated;
+        if (pSymbol->get_undecoratedNameEx(undname_name_only, &undecorated) != S_OK || !undecorated.m_str)
+        {
+            continue;
+        }
+        std::wstring undecorated_name(undecorated.m_str);
+        if (undecorated_name == info.name)
+        {
+            continue;
+        }
+        undecoratedNameIndex[FoldCase(undecorated_name)].push_back(pos);
+    }
+    alternateNameIndexesBuilt = true;
 }
@@ -1,12 +1,23 @@
-#pragma once
+﻿#pragma once
 #include <string>
 #include <atlbase.h>
 #include <dia2.h>
+#include "OffsetDatabase.h"
+#include "CompiledLayout.h"
+#include "ListWalker.h"
+#include "X64Unwinder.h"
+#include "PdbFile.h"
 #include <optional>
 #include <map>
 #include <list>
 #include <cstdint>
 #include <vector>
+#include <mutex>
+#include <set>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <deque>
 
 class PDBReader
 {
@@ -44,6 +55,261 @@ public:
         TypeInfo type;
         std::wstring name;
         uint32_t offset;
+        // if the field is a bitfield, bit_length is 0 otherwise
+        uint32_t bit_position;
+        uint32_t bit_length;
+    };
+
+    class SymbolInfo
+    {
+    public:
+        DWORD sym_index_id;
+        DWORD tag;
+        DWORD rva;
+        ULONGLONG length;
+        std::wstring name;
+    };
+
+    enum class SearchMode
+    {
+        // names starting with the pattern
+        Prefix,
+        // '*' matches any sequence, '?' matches one character
+        Wildcard,
+        // std::wregex ECMAScript syntax, must match the whole name
+        Regex,
+    };
+
+    class StructureChange
+    {
+    public:
+        enum class Kind
+        {
+            // member only exists in the newer build, with an empty member the whole structure does
+            Added,
+            // member only exists in the older build, with an empty member the whole structure does
+            Removed,
+            // member offset changed
+            Moved,
+            // member size changed, with an empty member the structure size did
+            Resized,
+            // same offset and size, but the member's type has a different layout
+            TypeChanged,
+            // the layout differs, but the members of either build could not all be read, so they are not compared
+            Unresolved,
+        };
+        std::wstring struct_name;
+        std::wstring member;
+        Kind kind;
+        // indexes into the readers passed to DiffStructures()
+        size_t old_build;
+        size_t new_build;
+        uint32_t old_offset;
+        uint32_t new_offset;
+        uint64_t old_size;
+        uint64_t new_size;
+    };
+
+    class EnumValues
+    {
+    public:
+        std::wstring name;
+        // enumerators in declaration order
+        std::vector<std::wstring> names;
+        std::vector<int64_t> values;
+
+        std::optional<int64_t> FindValue(const std::wstring& enumerator) const;
+
+        // first enumerator declared with value, nullptr if there is none
+        const std::wstring* FindName(int64_t value) const;
+
+        // enumerator -> index into names
+        std::unordered_map<std::wstring, uint32_t> by_name;
+        // (value, index into names), sorted
+        std::vector<std::pair<int64_t, uint32_t>> by_value;
+    };
+
+    class SectionInfo
+    {
+    public:
+        // up to 8 characters, not necessarily null terminated in the image
+        std::string name;
+        DWORD virtual_address;
+        DWORD virtual_size;
+        DWORD characteristics;
+    };
+
+    enum class OmapDirection
+    {
+        // rva of the original image (as the compiler laid it out) -> rva of the post-link optimized image
+        ToImage,
+        // rva of the optimized image -> rva of the original image
+        ToOriginal,
+    };
+
+    class SourceLocation
+    {
+    public:
+        std::wstring file;
+        uint32_t line;
+    };
+
+    class VariableInfo
+    {
+    public:
+        std::wstring name;
+        DWORD rva;
+        DWORD section;
+        DWORD offset;
+        uint64_t size;
+        // file static (S_LDATA32) rather than global (S_GDATA32)
+        bool is_static;
+        DWORD type_id;
+        TypeInfo type;
+    };
+
+    static constexpr uint32_t no_variable = 0xffffffff;
+
+    class LocalInfo
+    {
+    public:
+        std::wstring name;
+        // TPI type index, as recorded by the compiler
+        uint32_t type_index;
+        bool is_parameter;
+        // CV_HREG_e of the register holding the value, or of the base register for register_relative
+        DWORD register_id;
+        // the value is at [register + offset] rather than in the register
+        bool register_relative;
+        int32_t offset;
+    };
+
+    class FunctionSignature
+    {
+    public:
+        // CV_call_e
+        DWORD calling_convention;
+        DWORD return_type_id;
+        std::vector<DWORD> argument_type_ids;
+        // class of a member function, 0 otherwise
+        DWORD class_type_id;
+        // type of the this pointer, 0 for free and static member functions
+        DWORD this_type_id;
+        // ends with "...", which isn't part of argument_type_ids
+        bool variadic;
+    };
+
+    class VirtualSlot
+    {
+    public:
+        // class which declared the method or last overrode it
+        std::wstring class_name;
+        // empty for slots nothing in the pdb describes
+        std::wstring method;
+        // address of the code the slot is expected to point to, 0 if neither a function nor a public symbol gives one
+        DWORD rva;
+        bool pure;
+    };
+
+    class VirtualTable
+    {
+    public:
+        std::wstring class_name;
+        // rva of the class's own vftable (??_7Class@@6B@), 0 if it has no public symbol
+        DWORD vtable_rva;
+        // indexed by slot, slot * pointer size is the offset into the vtable
+        std::vector<VirtualSlot> slots;
+    };
+
+    class LayoutEntry
+    {
+    public:
+        enum class Kind
+        {
+            Field,
+            // base class subobject, its own entries follow it
+            BaseClass,
+            // virtual base subobject, placed once after the non-virtual part of the most derived class
+            VirtualBaseClass,
+            // pointer to a virtual function table
+            VfPtr,
+            // pointer to a virtual base table
+            VbPtr,
+            // bytes no field or pointer covers, between them or at the end
+            Padding,
+        };
+        Kind kind;
+        // field name, or class name of a base
+        std::wstring name;
+        // class declaring the entry, empty for padding
+        std::wstring owner;
+        // from the start of the most derived object
+        uint32_t offset;
+        uint64_t size;
+        // if the field is a bitfield, bit_length is 0 otherwise
+        uint32_t bit_position;
+        uint32_t bit_length;
+        // nesting level of the subobject declaring the entry, 0 for the class itself
+        uint32_t depth;
+        // type of a field or base, unknown for pointers and padding
+        TypeInfo type;
+        // a virtual base or one of its entries, placed by the MSVC layout rules because the pdb has no offset for it
+        bool derived_offset;
+    };
+
+    class LayoutReport
+    {
+    public:
+        std::wstring name;
+        uint64_t size;
+        uint32_t cache_line_size;
+        // GetFlattenedLayout() of the class, the indexes below point into it
+        std::vector<LayoutEntry> layout;
+        // all padding, tail_padding is the part after the last field
+        uint64_t padding_bytes;
+        uint64_t tail_padding;
+        // padding entries
+        std::vector<uint32_t> holes;
+        // fields and pointers crossing a cache line boundary
+        std::vector<uint32_t> line_crossings;
+        // fields and pointers touching each cache line, lines[i] covers [i * cache_line_size, (i + 1) * cache_line_size)
+        std::vector<std::vector<uint32_t>> lines;
+        // pairs of hot fields sharing a cache line
+        std::vector<std::pair<uint32_t, uint32_t>> false_sharing;
+    };
+
+    class LayoutWaste
+    {
+    public:
+        std::wstring name;
+        uint64_t size;
+        uint64_t padding_bytes;
+        uint64_t instances;
+        // padding_bytes * instances
+        uint64_t wasted_bytes;
+    };
+
+    class MemberQuery
+    {
+    public:
+        std::wstring struct_name;
+        std::wstring member;
+    };
+
+    class MemberResult
+    {
+    public:
+        enum class Status
+        {
+            Found,
+            StructNotFound,
+            MemberNotFound,
+        };
+        Status status;
+        DWORD offset;
+        // 0 if the member is not a bitfield
+        DWORD bit_position;
+        DWORD bit_length;
     };
 
     PDBReader(std::wstring pdb_name);
@@ -52,19 +318,96 @@ public:
 
     std::optional<DWORD> FindSymbol(std::wstring sym, DWORD& type);
 
+    // Returns every symbol in global scope named sym with a single enumeration, optionally only the ones with the given tag.
+    // Unlike FindSymbol(), an ambiguous name is not a failure.
+    std::vector<SymbolInfo> FindSymbols(const std::wstring& sym, enum SymTagEnum tag = SymTagNull);
+
+    // Picks the match with the largest length, so forward declarations lose against the definition
+    // and duplicated UDTs from different compilands resolve to one of them.
+    std::optional<SymbolInfo> FindBestSymbol(const std::wstring& sym, enum SymTagEnum tag = SymTagNull);
+
+    // Streams every global symbol whose name matches pattern to callback, in name order, until callback returns false or limit is reached.
+    // Backed by a sorted name index built on first use: prefix search costs O(log n + k), wildcard patterns are narrowed
+    // to the range of their literal prefix, regex patterns anchored with a literal prefix are narrowed the same way.
+    // Returns the number of symbols passed to callback.
+    size_t SearchSymbols(const std::wstring& pattern, SearchMode mode, const std::function<bool(const SymbolInfo&)>& callback,
+        enum SymTagEnum tag = SymTagNull, size_t limit = SIZE_MAX);
+
+    // Secondary lookups over the same name index, each one a single hash probe after the indexes are built on first use.
+    // Names are compared case-insensitively. The undecorated index is keyed by the undecorated name of MSVC decorated
+    // publics, e.g. "Bar::Foo" finds "?Foo@Bar@@QEAAXXZ".
+    std::vector<SymbolInfo> FindSymbolsCaseInsensitive(const std::wstring& name);
+
+    std::vector<SymbolInfo> FindSymbolsByUndecoratedName(const std::wstring& name);
+
+    // Union of the two above, exact spellings first.
+    std::vector<SymbolInfo> FindSymbolsAnySpelling(const std::wstring& name);
+
     std::optional<DWORD> FindConst(std::wstring const_name);
 
     std::optional<DWORD> FindFunction(std::wstring func);
 
+    // Enumerators of an enum with hashed name and sorted value lookups. Cached per enum, the table is owned by the reader.
+    // nullptr if there is no such enum.
+    const EnumValues* GetEnum(const std::wstring& enumName);
+
+    std::optional<int64_t> FindEnumValue(const std::wstring& enumName, const std::wstring& enumerator);
+
+    // First enumerator declared with value, nullptr if there is none.
+    const std::wstring* FindEnumName(const std::wstring& enumName, int64_t value);
+
+    // Value of a named constant (S_CONSTANT), FindConst() gives the address of a variable instead.
+    std::optional<int64_t> FindConstantValue(const std::wstring& name);
+
+    // Writes every enumerator of every enum as "enum\tenumerator\tvalue" lines.
+    void DumpEnums(const std::wstring& out_file);
+
+    // File and line a structure, class, union or enum was defined at. Read from the pdb file directly, as DIA doesn't expose it.
+    std::optional<SourceLocation> FindTypeSource(const std::wstring& typeName);
+
+    // Writes "type\tfile\tline" for every type with a known definition location.
+    void DumpTypeSources(const std::wstring& out_file);
+
     std::optional<DWORD> FindStructMemberOffset(std::wstring structName, std::wstring memberName);
 
     std::optional<UINT64> FindStructSize(std::wstring structName);
 
+    // FindStructMemberOffset() for a whole manifest, one result per query in the same order.
+    // Queries are grouped by structure, so every structure is looked up and enumerated once.
+    std::vector<MemberResult> ResolveOffsets(const std::vector<MemberQuery>& queries);
+
     bool FindMostRelatedFunctionName(DWORD rva, std::wstring& funcname);
 
+    // FindMostRelatedFunctionName() for many addresses in one merge pass, an empty name where no function starts below.
+    // Pass X64Unwinder::Frame::lookup_rva for stack frames, return addresses may already lie past the calling function.
+    std::vector<std::wstring> FindFunctionsFromRVAs(const std::vector<DWORD>& rvas);
+
     void FindNearestSymbolFromRVA(DWORD rva, std::wstring& symbolName, DWORD& symbolType);
 
-    void DumpTypes(enum SymTagEnum type, const std::wstring out_file);
+    // Every global and file static variable with its type, sorted by rva. Built on first use.
+    const std::vector<VariableInfo>& GetGlobalVariables();
+
+    // Variable covering rva, offset receives the position of rva inside of it.
+    std::optional<VariableInfo> FindVariableFromRVA(DWORD rva, DWORD& offset);
+
+    // FindVariableFromRVA() for many addresses in one merge pass, indexes into GetGlobalVariables() or no_variable.
+    std::vector<uint32_t> FindVariablesFromRVAs(const std::vector<DWORD>& rvas);
+
+    // Locals and parameters of the function at rva which are live there, with where they are kept.
+    // Read from the module symbols of the pdb file directly, one module at a time as its functions are asked for.
+    std::vector<LocalInfo> FindLocalsFromRVA(DWORD rva);
+
+    // With undecorate set, a third column holds the undecorated name of every decorated symbol.
+    void DumpTypes(enum SymTagEnum type, const std::wstring out_file, bool undecorate = false);
+
+    // Full undecorated form of an MSVC decorated name, e.g. "public: void __cdecl Bar::Foo(void)" for "?Foo@Bar@@QEAAXXZ".
+    // Undecorated by the reader's own DIA session, so readers on different threads don't share any state.
+    // Results are memoized by decorated name. Names which are not decorated are returned unchanged.
+    std::wstring UndecorateName(const SymbolInfo& sym);
+
+    // Enumerates every name in global scope once and builds a bloom filter over them,
+    // after that FindSymbol() rejects names which are not in the pdb without calling into DIA.
+    void BuildSymbolNameFilter();
 
     const std::vector<FieldInfo> GetStructureFields(const std::wstring& structName);
 
@@ -72,6 +415,82 @@ public:
 
     const TypeInfo GetTypeInfo(DWORD symbolId);
 
+    // Resolves a structure into a CompiledLayout for decoding raw memory buffers.
+    std::optional<CompiledLayout> CompileLayout(const std::wstring& structName);
+
+    // Walker for the intrusive list listField (LIST_ENTRY or SINGLE_LIST_ENTRY) of structName, decoding fields of every element.
+    std::optional<ListWalker> CompileListWalker(const std::wstring& structName, const std::wstring& listField, const std::vector<std::wstring>& fields);
+
+    // Structural hash of a type: its size and, for UDTs, name, offset, bitfield and type hash of every member and base class, recursively.
+    // Pointers are hashed by size only. Types with equal hashes have the same layout, in this pdb or any other. Cached per type.
+    uint64_t GetTypeHash(DWORD symbolId);
+
+    std::optional<uint64_t> GetStructureHash(const std::wstring& structName);
+
+    // Signature of a function (SymTagFunction) or function type (SymTagFunctionType), nullptr if it has none.
+    // Identical signatures are stored once, so the returned pointers can be compared directly. Owned by the reader.
+    const FunctionSignature* GetFunctionSignature(DWORD symbolId);
+
+    // Calls callback with every function and its signature until it returns false.
+    void ForEachFunctionSignature(const std::function<bool(const SymbolInfo&, const FunctionSignature*)>& callback);
+
+    // Primary vtable of a class (the one at offset 0), with the slots inherited from the bases at offset 0.
+    // Methods overriding slots of secondary vtables and of virtual bases are not part of it.
+    // Slots without a function rva are joined against the public symbols by undecorated name.
+    std::optional<VirtualTable> GetVirtualTable(const std::wstring& className);
+
+    // GetVirtualTable() for every class with virtual methods. Bases shared by many classes are resolved once,
+    // and the public symbols are indexed once for all the joins.
+    std::vector<VirtualTable> GetVirtualTables();
+
+    // Layout of a class with the members of all its bases, at their offsets in the object, sorted by offset.
+    // Virtual bases are placed the way MSVC lays them out, after the non-virtual part in vbtable order.
+    // Their offsets are derived rather than read (see LayoutEntry::derived_offset), vtordisp fields in front of them and
+    // __declspec(align) are not accounted for. When the derived layout doesn't add up to the class size, only the holes
+    // of the non-virtual part are reported. Cached per class.
+    const std::vector<LayoutEntry> GetFlattenedLayout(const std::wstring& className);
+
+    // Holes, tail padding and cache line usage of a class, from its flattened layout. Hot fields are the ones written
+    // often or by different threads, given as "member" or "Class::member"; any two of them on one line are reported.
+    std::optional<LayoutReport> AnalyzeLayout(const std::wstring& className, uint32_t cacheLineSize = 64, const std::vector<std::wstring>& hotFields = {});
+
+    // Padding of every UDT times its expected instance count (1 for types without a hint), largest waste first.
+    // Anonymous types are left out, their padding shows up in the types declaring them.
+    std::vector<LayoutWaste> RankLayoutsByWaste(const std::unordered_map<std::wstring, uint64_t>& instanceHints = {});
+
+    // Compares every structure between each pair of consecutive builds (builds[0] -> builds[1], builds[1] -> builds[2], ...).
+    // Structures with equal structural hashes are skipped right away. Readers are queried in parallel, one worker each,
+    // so they must live in the multithreaded apartment (the CoInit() default) and must not be used by anybody else during the call.
+    static std::vector<StructureChange> DiffStructures(const std::vector<PDBReader*>& builds, const std::vector<std::wstring>& structNames, unsigned threads = 0);
+
+    // Identity of the loaded pdb, the same pair the symbol server and the executable's debug directory use.
+    bool GetGuidAndAge(GUID& guid, DWORD& age);
+
+    // Section headers from the pdb's debug streams.
+    std::vector<SectionInfo> GetSections();
+
+    // section is 1-based, as in symbol records. On images with OMAP, section:offset is in the original layout the
+    // symbols use and is translated to the image. Nothing is returned for removed code.
+    std::optional<DWORD> SectionOffsetToRVA(DWORD section, DWORD offset);
+
+    // True if the image was rearranged after linking (BBT, old PGO builds) and carries OMAP tables.
+    bool HasOmap();
+
+    // Translates through the OMAP tables, identity if there are none. Nothing is returned for code that was removed.
+    std::optional<DWORD> TranslateRVA(DWORD rva, OmapDirection direction);
+
+    // TranslateRVA() for many addresses in one merge pass over the table, 0 for addresses without a mapping.
+    std::vector<DWORD> TranslateRVAs(const std::vector<DWORD>& rvas, OmapDirection direction);
+
+    // Unwinder for stacks of this image, built from the .pdata and .xdata copies in the pdb. Nothing for non x64 images.
+    std::optional<X64Unwinder> CreateX64Unwinder();
+
+    // Writes a C++ header with constexpr size, member offsets, member sizes and bitfield masks of the given structures,
+    // in a namespace named after the pdb's guid and age, so known builds need no pdb at runtime.
+    // Structures listed twice are written once, names which sanitize to the same identifier get a numeric suffix.
+    // Structures which cannot be found and members which cannot be resolved are listed in comments at the end of the header.
+    void GenerateOffsetHeader(const std::vector<std::wstring>& structNames, const std::wstring& out_file);
+
     // Helper function
     static void DownloadPDBForFile(std::wstring executable_name, std::wstring symbol_folder, std::wstring SYMBOL_SERVER_URL = L"https://msdl.microsoft.com/download/symbols");
 
@@ -79,23 +498,126 @@ public:
 
     static void SetMsdiaDllPath(std::wstring p);
 
+    // Opens the pdbs in parallel, one reader per worker thread, resolves every query against each of them and writes
+    // the results into one OffsetDatabase file keyed by (guid, age). threads = 0 uses one worker per hardware thread.
+    // Returns the pdbs which could not be opened, they are left out of the database.
+    static std::vector<std::wstring> BuildOffsetDatabase(const std::vector<std::wstring>& pdbs, const std::vector<OffsetDatabase::Query>& queries,
+        const std::wstring& out_file, unsigned threads = 0);
+
+    // Process wide call counts, latency histograms and cache hit rates of all readers.
+    // Collected only when PDBREADER_ENABLE_STATS is defined, otherwise an empty snapshot is returned.
+    static std::string ExportStatsJson();
+
+    static std::string ExportStatsPrometheus();
+
 private:
     static HRESULT CreateDiaDataSourceWithoutComRegistration(IDiaDataSource** data_source);
 
     static inline std::wstring dia_dll_name = L"msdia140.dll";
     static inline std::wstring dia_dll_full_path = L"";
 
+    // msdia dll and its class factory are loaded once and kept for the whole process lifetime,
+    // so creating a data source is a single CreateInstance() call after the first reader.
+    static inline std::mutex dia_factory_lock;
+    static inline HMODULE dia_module = nullptr;
+    static inline IClassFactory* dia_class_factory = nullptr;
+
     CComPtr<IDiaSession> pSession;
     CComPtr<IDiaSymbol> pGlobal;
 
     std::map<std::wstring, DWORD> symbolRVACache;
+    // names which are not found or are ambiguous
+    std::set<std::wstring> symbolMissCache;
+    std::vector<uint64_t> symbolNameFilter;
     std::map<DWORD, TypeInfo> symbolTypeInfoCache;
     std::map<DWORD, std::vector<FieldInfo>> structureFieldInfoCache;
+    std::map<DWORD, uint64_t> typeHashCache;
+    std::map<std::wstring, EnumValues> enumCache;
+    // function type id -> signature
+    std::map<DWORD, const FunctionSignature*> functionSignatureCache;
+    // a deque keeps the signatures in place as it grows
+    std::deque<FunctionSignature> functionSignatures;
+    // hash of a signature -> signatures with that hash
+    std::unordered_map<uint64_t, std::vector<const FunctionSignature*>> functionSignatureIndex;
+    // UDT id -> slots of its primary vtable, before the join with the publics
+    std::map<DWORD, std::vector<VirtualSlot>> virtualSlotCache;
+    std::map<DWORD, std::vector<LayoutEntry>> flattenedLayoutCache;
+    // (type id, without virtual bases) -> alignment
+    std::map<std::pair<DWORD, bool>, uint32_t> typeAlignmentCache;
 
     const std::vector<FieldInfo> GetStructureFields(IDiaSymbol* sym);
 
+    // Data members taking room in the object. Unlike GetStructureFields(), a member which can't be read is skipped
+    // and its name added to failed, instead of failing the whole structure. Not cached.
+    std::vector<FieldInfo> ReadStructureFields(IDiaSymbol* sym, std::vector<std::wstring>& failed);
+
+    CComPtr<IDiaSymbol> FindUDT(const std::wstring& structName);
+
+    bool ReadEnumValues(IDiaSymbol* sym, EnumValues& out);
+
+    const std::vector<VirtualSlot>& GetVirtualSlots(IDiaSymbol* udt, int depth);
+
+    // fills the vtable rva and the missing slot rvas from the public symbols
+    void ResolveVirtualTable(VirtualTable& table);
+
+    DWORD GetPointerSize();
+
+    // natural alignment of a type, from the alignments of its members. non_virtual leaves out the virtual bases of a class,
+    // as a base subobject is aligned without them.
+    uint32_t GetTypeAlignment(IDiaSymbol* type, bool non_virtual = false, uint32_t depth = 0);
+
+    // appends the entries of udt placed at base_offset, virtual bases are only laid out for the most derived class
+    void FlattenLayout(IDiaSymbol* udt, uint32_t base_offset, uint32_t depth, bool most_derived, std::vector<LayoutEntry>& out);
+
+    // GetFlattenedLayout() of a type already at hand, saves the lookup by name
+    const std::vector<LayoutEntry> GetFlattenedLayout(IDiaSymbol* pSymbol);
+
+    // Concatenated records of a debug stream (SECTIONHEADERS, OMAPTO, PDATA, ...). rva receives the address the data was copied from.
+    bool ReadDebugStream(const std::wstring& name, std::vector<BYTE>& data, DWORD* rva);
+
+    void LoadDebugStreams();
+
+    // the loaded pdb opened directly, for the streams DIA doesn't expose. nullptr if it can't be opened.
+    PdbFile* GetPdbFile();
+
+    std::unique_ptr<PdbFile> pdbFile;
+    bool pdbFileOpened = false;
+
+    bool debugStreamsLoaded = false;
+    std::vector<SectionInfo> sections;
+    // section headers before the image was rearranged, only present with OMAP
+    std::vector<SectionInfo> originalSections;
+    // (from, to) sorted by from, as stored in the OMAPTO / OMAPFROM streams
+    std::vector<std::pair<DWORD, DWORD>> omapTo;
+    std::vector<std::pair<DWORD, DWORD>> omapFrom;
+
+    std::wstring UndecorateSymbol(IDiaSymbol* sym, const std::wstring& name);
+
+    // decorated name -> undecorated name
+    std::unordered_map<std::wstring, std::wstring> undecoratedNameCache;
+
+    bool SymbolNameFilterMayContain(const std::wstring& name);
+
     void BuildSortedFunctionRVANameList();
 
-    std::list<std::tuple<uint32_t, std::wstring>> SortedFunctionRVANameList;
+    std::vector<std::tuple<uint32_t, std::wstring>> SortedFunctionRVANameList;
+
+    void BuildSortedSymbolNameIndex();
+
+    std::vector<SymbolInfo> SortedSymbolNameIndex;
+
+    void BuildGlobalVariableTable();
+
+    // sorted by rva, with the start addresses repeated in their own array for the searches
+    std::vector<VariableInfo> globalVariables;
+    std::vector<DWORD> globalVariableRVAs;
+    bool globalVariableTableBuilt = false;
+
+    void BuildAlternateNameIndexes();
+
+    // case folded name -> positions in SortedSymbolNameIndex
+    std::unordered_map<std::wstring, std::vector<uint32_t>> caseFoldedNameIndex;
+    std::unordered_map<std::wstring, std::vector<uint32_t>> undecoratedNameIndex;
+    bool alternateNameIndexesBuilt = false;
 
 };
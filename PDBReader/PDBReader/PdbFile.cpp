@@ -0,0 +1,1040 @@
+#include "PdbFile.h"
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    const char msf_magic[32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+
+    struct SuperBlock
+    {
+        char magic[32];
+        uint32_t block_size;
+        uint32_t free_block_map_block;
+        uint32_t block_count;
+        uint32_t directory_bytes;
+        uint32_t unknown;
+        // block holding the list of directory blocks
+        uint32_t block_map_block;
+    };
+
+    constexpr uint32_t nil_stream_size = 0xffffffff;
+    constexpr uint32_t info_stream = 1;
+    constexpr uint32_t tpi_stream = 2;
+    constexpr uint32_t ipi_stream = 4;
+    // version, signature, age, guid
+    constexpr uint32_t info_header_size = 28;
+    constexpr uint32_t names_signature = 0xeffeeffe;
+    constexpr uint32_t names_header_size = 12;
+    constexpr uint32_t type_stream_min_header_size = 56;
+    constexpr uint16_t property_forward_reference = 0x80;
+    constexpr uint32_t dbi_stream = 3;
+    constexpr uint32_t dbi_header_size = 64;
+    // fixed part of a module info record, the module and object names follow
+    constexpr uint32_t module_info_size = 64;
+    constexpr uint32_t section_contribution_v60 = 0xeffe0000 + 19970605;
+    constexpr uint32_t section_contribution_v2 = 0xeffe0000 + 20140516;
+    constexpr uint16_t nil_stream_index = 0xffff;
+
+    // symbol record kinds
+    constexpr uint16_t S_END = 0x0006;
+    constexpr uint16_t S_FRAMEPROC = 0x1012;
+    constexpr uint16_t S_THUNK32 = 0x1102;
+    constexpr uint16_t S_BLOCK32 = 0x1103;
+    constexpr uint16_t S_WITH32 = 0x1104;
+    constexpr uint16_t S_REGISTER = 0x1106;
+    constexpr uint16_t S_BPREL32 = 0x110b;
+    constexpr uint16_t S_LPROC32 = 0x110f;
+    constexpr uint16_t S_GPROC32 = 0x1110;
+    constexpr uint16_t S_REGREL32 = 0x1111;
+    constexpr uint16_t S_SEPCODE = 0x1132;
+    constexpr uint16_t S_LOCAL = 0x113e;
+    constexpr uint16_t S_DEFRANGE_REGISTER = 0x1141;
+    constexpr uint16_t S_DEFRANGE_FRAMEPOINTER_REL = 0x1142;
+    constexpr uint16_t S_DEFRANGE_FRAMEPOINTER_REL_FULL_SCOPE = 0x1144;
+    constexpr uint16_t S_DEFRANGE_REGISTER_REL = 0x1145;
+    constexpr uint16_t S_LPROC32_ID = 0x1146;
+    constexpr uint16_t S_GPROC32_ID = 0x1147;
+    constexpr uint16_t S_INLINESITE = 0x114d;
+    constexpr uint16_t S_INLINESITE_END = 0x114e;
+    constexpr uint16_t S_PROC_ID_END = 0x114f;
+    constexpr uint16_t S_INLINESITE2 = 0x115d;
+
+    // CV_HREG_e values of the frame base registers
+    constexpr uint16_t CV_REG_NONE = 0;
+    constexpr uint16_t CV_REG_EBX = 20;
+    constexpr uint16_t CV_REG_EBP = 22;
+    constexpr uint16_t CV_ALLREG_VFRAME = 30006;
+    constexpr uint16_t CV_AMD64_RBP = 334;
+    constexpr uint16_t CV_AMD64_RSP = 335;
+    constexpr uint16_t CV_AMD64_R13 = 341;
+    constexpr uint16_t image_file_machine_amd64 = 0x8664;
+
+    uint32_t Load32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint16_t Load16(const uint8_t* p)
+    {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // string hashes of the /names buckets, version 1 and 2
+    uint32_t HashStringV1(const std::string& str)
+    {
+        uint32_t hash = 0;
+        size_t i = 0;
+        for (; i + 4 <= str.size(); i += 4)
+        {
+            hash ^= Load32((const uint8_t*)str.data() + i);
+        }
+        if (str.size() - i >= 2)
+        {
+            hash ^= Load16((const uint8_t*)str.data() + i);
+            i += 2;
+        }
+        if (i < str.size())
+        {
+            hash ^= (uint8_t)str[i];
+        }
+        hash |= 0x20202020;
+        hash ^= hash >> 11;
+        return hash ^ (hash >> 16);
+    }
+
+    uint32_t HashStringV2(const std::string& str)
+    {
+        uint32_t hash = 0xb170a1bf;
+        size_t i = 0;
+        for (; i + 4 <= str.size(); i += 4)
+        {
+            hash += Load32((const uint8_t*)str.data() + i);
+            hash += hash << 10;
+            hash ^= hash >> 6;
+        }
+        for (; i < str.size(); i++)
+        {
+            hash += (uint8_t)str[i];
+            hash += hash << 10;
+            hash ^= hash >> 6;
+        }
+        return hash * 1664525u + 1013904223u;
+    }
+}
+
+PdbFile::PdbFile(std::wstring pdb_file)
+{
+    file = CreateFileW(pdb_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::exception("Could not open pdb file.");
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(SuperBlock))
+    {
+        CloseHandle(file);
+        throw std::exception("Pdb file is truncated.");
+    }
+    file_size = size.QuadPart;
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        throw std::exception("Could not map pdb file.");
+    }
+    base = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::exception("Could not map pdb file.");
+    }
+
+    auto fail = [&](const char* message) {
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::exception(message);
+    };
+    SuperBlock super;
+    memcpy(&super, base, sizeof(super));
+    block_size = super.block_size;
+    if (memcmp(super.magic, msf_magic, sizeof(msf_magic)) != 0
+        || (block_size != 512 && block_size != 1024 && block_size != 2048 && block_size != 4096))
+    {
+        fail("Not an msf 7.0 pdb file.");
+    }
+    auto block_valid = [&](uint32_t block) {
+        return (uint64_t)block * block_size + block_size <= file_size;
+    };
+
+    // the directory is a stream itself, its block list lives in block_map_block
+    uint32_t directory_block_count = (super.directory_bytes + block_size - 1) / block_size;
+    if (!block_valid(super.block_map_block) || directory_block_count > block_size / sizeof(uint32_t))
+    {
+        fail("Pdb stream directory is corrupted.");
+    }
+    std::vector<uint8_t> directory((size_t)directory_block_count * block_size);
+    for (uint32_t i = 0; i < directory_block_count; i++)
+    {
+        uint32_t block = Load32(base + (uint64_t)super.block_map_block * block_size + i * sizeof(uint32_t));
+        if (!block_valid(block))
+        {
+            fail("Pdb stream directory is corrupted.");
+        }
+        memcpy(directory.data() + (size_t)i * block_size, base + (uint64_t)block * block_size, block_size);
+    }
+
+    // stream count, stream sizes, then the blocks of every stream
+    size_t pos = 0;
+    auto next = [&](uint32_t& value) {
+        if (pos + sizeof(uint32_t) > super.directory_bytes)
+        {
+            return false;
+        }
+        value = Load32(directory.data() + pos);
+        pos += sizeof(uint32_t);
+        return true;
+    };
+    uint32_t stream_count;
+    if (!next(stream_count) || stream_count > super.directory_bytes / sizeof(uint32_t))
+    {
+        fail("Pdb stream directory is corrupted.");
+    }
+    stream_sizes.resize(stream_count);
+    for (auto& stream_size : stream_sizes)
+    {
+        if (!next(stream_size))
+        {
+            fail("Pdb stream directory is corrupted.");
+        }
+        if (stream_size == nil_stream_size)
+        {
+            stream_size = 0;
+        }
+    }
+    stream_blocks.resize(stream_count);
+    for (uint32_t i = 0; i < stream_count; i++)
+    {
+        stream_blocks[i].resize((stream_sizes[i] + (uint64_t)block_size - 1) / block_size);
+        for (auto& block : stream_blocks[i])
+        {
+            if (!next(block) || !block_valid(block))
+            {
+                fail("Pdb stream directory is corrupted.");
+            }
+        }
+    }
+}
+
+PdbFile::~PdbFile()
+{
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+uint32_t PdbFile::StreamCount() const
+{
+    return (uint32_t)stream_sizes.size();
+}
+
+uint32_t PdbFile::StreamSize(uint32_t stream) const
+{
+    return stream < stream_sizes.size() ? stream_sizes[stream] : 0;
+}
+
+const uint8_t* PdbFile::StreamData(uint32_t stream)
+{
+    if (stream >= stream_sizes.size() || !stream_sizes[stream])
+    {
+        return nullptr;
+    }
+    auto& blocks = stream_blocks[stream];
+    bool contiguous = true;
+    for (size_t i = 1; i < blocks.size() && contiguous; i++)
+    {
+        contiguous = blocks[i] == blocks[i - 1] + 1;
+    }
+    if (contiguous)
+    {
+        return base + (uint64_t)blocks[0] * block_size;
+    }
+
+    auto assembled = assembled_streams.find(stream);
+    if (assembled == assembled_streams.end())
+    {
+        std::vector<uint8_t> data((size_t)blocks.size() * block_size);
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            memcpy(data.data() + i * block_size, base + (uint64_t)blocks[i] * block_size, block_size);
+        }
+        assembled = assembled_streams.emplace(stream, std::move(data)).first;
+    }
+    return assembled->second.data();
+}
+
+std::optional<uint32_t> PdbFile::FindNamedStream(const std::string& name)
+{
+    auto data = StreamData(info_stream);
+    uint32_t size = StreamSize(info_stream);
+    // string buffer, then a hash table of (offset in string buffer, stream index) with present and deleted bit vectors
+    uint64_t pos = info_header_size;
+    auto next = [&](uint32_t& value) {
+        if (pos + sizeof(uint32_t) > size)
+        {
+            return false;
+        }
+        value = Load32(data + pos);
+        pos += sizeof(uint32_t);
+        return true;
+    };
+    uint32_t strings_size;
+    if (!data || !next(strings_size) || pos + strings_size > size)
+    {
+        return {};
+    }
+    auto strings = (const char*)data + pos;
+    pos += strings_size;
+
+    uint32_t entry_count, capacity, present_words;
+    if (!next(entry_count) || !next(capacity) || !next(present_words) || pos + (uint64_t)present_words * sizeof(uint32_t) > size)
+    {
+        return {};
+    }
+    auto present = data + pos;
+    pos += (uint64_t)present_words * sizeof(uint32_t);
+    uint32_t deleted_words;
+    if (!next(deleted_words))
+    {
+        return {};
+    }
+    pos += (uint64_t)deleted_words * sizeof(uint32_t);
+    for (uint32_t i = 0; i < capacity && i / 32 < present_words; i++)
+    {
+        if (!((Load32(present + i / 32 * sizeof(uint32_t)) >> (i % 32)) & 1))
+        {
+            continue;
+        }
+        uint32_t key, value;
+        if (!next(key) || !next(value))
+        {
+            return {};
+        }
+        if (key < strings_size && strnlen(strings + key, strings_size - key) == name.size() && memcmp(strings + key, name.data(), name.size()) == 0)
+        {
+            return value;
+        }
+    }
+    return {};
+}
+
+void PdbFile::LoadNames()
+{
+    if (names_loaded)
+    {
+        return;
+    }
+    names_loaded = true;
+    auto stream = FindNamedStream("/names");
+    if (!stream)
+    {
+        return;
+    }
+    auto data = StreamData(*stream);
+    uint32_t size = StreamSize(*stream);
+    if (!data || size < names_header_size || Load32(data) != names_signature)
+    {
+        return;
+    }
+    uint32_t strings_size = Load32(data + 8);
+    uint64_t buckets_pos = (uint64_t)names_header_size + strings_size;
+    if (buckets_pos + sizeof(uint32_t) > size)
+    {
+        return;
+    }
+    uint32_t bucket_count = Load32(data + buckets_pos);
+    if (buckets_pos + sizeof(uint32_t) + (uint64_t)bucket_count * sizeof(uint32_t) > size)
+    {
+        return;
+    }
+    names_hash_version = Load32(data + 4);
+    names_strings = (const char*)data + names_header_size;
+    names_strings_size = strings_size;
+    names_buckets = data + buckets_pos + sizeof(uint32_t);
+    names_bucket_count = bucket_count;
+}
+
+const char* PdbFile::FindString(uint32_t offset)
+{
+    LoadNames();
+    // every string is null terminated, the check keeps a corrupted last one from running off the table
+    if (offset >= names_strings_size || !memchr(names_strings + offset, 0, names_strings_size - offset))
+    {
+        return nullptr;
+    }
+    return names_strings + offset;
+}
+
+std::optional<uint32_t> PdbFile::FindStringOffset(const std::string& str)
+{
+    LoadNames();
+    if (!names_bucket_count)
+    {
+        return {};
+    }
+    uint32_t start = (names_hash_version == 1 ? HashStringV1(str) : HashStringV2(str)) % names_bucket_count;
+    // open addressing with linear probing, an empty bucket ends the search
+    for (uint32_t i = 0; i < names_bucket_count; i++)
+    {
+        uint32_t offset = Load32(names_buckets + (uint64_t)((start + i) % names_bucket_count) * sizeof(uint32_t));
+        if (!offset)
+        {
+            return {};
+        }
+        auto candidate = FindString(offset);
+        if (candidate && str == candidate)
+        {
+            return offset;
+        }
+    }
+    return {};
+}
+
+void PdbFile::LoadTypeStream(uint32_t stream, TypeStream& out)
+{
+    if (out.loaded)
+    {
+        return;
+    }
+    out.loaded = true;
+    auto data = StreamData(stream);
+    uint32_t size = StreamSize(stream);
+    if (!data || size < type_stream_min_header_size)
+    {
+        return;
+    }
+    uint32_t header_size = Load32(data + 4);
+    uint32_t begin = Load32(data + 8);
+    uint32_t end = Load32(data + 12);
+    uint32_t record_bytes = Load32(data + 16);
+    if (header_size < type_stream_min_header_size || end < begin || (uint64_t)header_size + record_bytes > size)
+    {
+        return;
+    }
+
+    // records are 2 bytes of length (not counting itself), 2 bytes of kind, then the contents
+    auto records = data + header_size;
+    std::vector<uint32_t> offsets;
+    offsets.reserve(end - begin);
+    uint32_t pos = 0;
+    while (pos + 4 <= record_bytes && offsets.size() < end - begin)
+    {
+        uint16_t length = Load16(records + pos);
+        if (length < 2 || pos + 2 + length > record_bytes)
+        {
+            break;
+        }
+        offsets.push_back(pos);
+        pos += 2 + length;
+    }
+    out.begin = begin;
+    out.end = begin + (uint32_t)offsets.size();
+    out.records = records;
+    out.offsets = std::move(offsets);
+}
+
+std::optional<PdbFile::Record> PdbFile::FindRecord(TypeStream& types, uint32_t type_index)
+{
+    if (type_index < types.begin || type_index >= types.end)
+    {
+        return {};
+    }
+    auto record = types.records + types.offsets[type_index - types.begin];
+    return Record{ Load16(record + 2), record + 4, (uint16_t)(Load16(record) - 2) };
+}
+
+uint32_t PdbFile::TypeBegin()
+{
+    LoadTypeStream(tpi_stream, tpi);
+    return tpi.begin;
+}
+
+uint32_t PdbFile::TypeEnd()
+{
+    LoadTypeStream(tpi_stream, tpi);
+    return tpi.end;
+}
+
+std::optional<PdbFile::Record> PdbFile::FindTypeRecord(uint32_t type_index)
+{
+    LoadTypeStream(tpi_stream, tpi);
+    return FindRecord(tpi, type_index);
+}
+
+uint32_t PdbFile::IdBegin()
+{
+    LoadTypeStream(ipi_stream, ipi);
+    return ipi.begin;
+}
+
+uint32_t PdbFile::IdEnd()
+{
+    LoadTypeStream(ipi_stream, ipi);
+    return ipi.end;
+}
+
+std::optional<PdbFile::Record> PdbFile::FindIdRecord(uint32_t type_index)
+{
+    LoadTypeStream(ipi_stream, ipi);
+    return FindRecord(ipi, type_index);
+}
+
+const char* PdbFile::FindUDTName(uint32_t type_index)
+{
+    auto record = FindTypeRecord(type_index);
+    if (!record)
+    {
+        return nullptr;
+    }
+    // fixed part up to the size, which is a numeric leaf for classes and unions
+    uint32_t pos;
+    bool has_size = true;
+    switch (record->kind)
+    {
+    case LF_CLASS:
+    case LF_STRUCTURE:
+    case LF_INTERFACE:
+        // count, property, field list, derived list, vtable shape
+        pos = 16;
+        break;
+    case LF_UNION:
+        // count, property, field list
+        pos = 8;
+        break;
+    case LF_ENUM:
+        // count, property, underlying type, field list
+        pos = 12;
+        has_size = false;
+        break;
+    default:
+        return nullptr;
+    }
+    if (pos > record->size)
+    {
+        return nullptr;
+    }
+    if (has_size)
+    {
+        if (pos + 2 > record->size)
+        {
+            return nullptr;
+        }
+        uint16_t leaf = Load16(record->data + pos);
+        pos += 2;
+        // values below LF_NUMERIC (0x8000) are stored in the leaf itself
+        if (leaf >= 0x8000)
+        {
+            switch (leaf)
+            {
+            case 0x8000: // LF_CHAR
+                pos += 1;
+                break;
+            case 0x8001: // LF_SHORT
+            case 0x8002: // LF_USHORT
+                pos += 2;
+                break;
+            case 0x8003: // LF_LONG
+            case 0x8004: // LF_ULONG
+                pos += 4;
+                break;
+            case 0x8009: // LF_QUADWORD
+            case 0x800a: // LF_UQUADWORD
+                pos += 8;
+                break;
+            default:
+                return nullptr;
+            }
+        }
+    }
+    if (pos >= record->size || !memchr(record->data + pos, 0, record->size - pos))
+    {
+        return nullptr;
+    }
+    return (const char*)record->data + pos;
+}
+
+std::optional<uint32_t> PdbFile::FindUDTTypeIndex(const std::string& name)
+{
+    if (!udt_type_indexes_built)
+    {
+        udt_type_indexes_built = true;
+        for (uint32_t ti = TypeBegin(); ti < TypeEnd(); ti++)
+        {
+            auto udt_name = FindUDTName(ti);
+            // the property bitfield follows the 2 byte count in every UDT record
+            if (udt_name && !(Load16(FindTypeRecord(ti)->data + 2) & property_forward_reference))
+            {
+                udt_type_indexes.emplace(udt_name, ti);
+            }
+        }
+    }
+    auto it = udt_type_indexes.find(name);
+    if (it == udt_type_indexes.end())
+    {
+        return {};
+    }
+    return it->second;
+}
+
+void PdbFile::LoadTypeSources()
+{
+    if (type_sources_loaded)
+    {
+        return;
+    }
+    type_sources_loaded = true;
+    type_sources.assign(TypeEnd() - TypeBegin(), { nullptr, 0 });
+    // one pass over the ids, filling a dense array indexed by the type
+    for (uint32_t id = IdBegin(); id < IdEnd(); id++)
+    {
+        auto record = FindIdRecord(id);
+        // type, source file, line, and for LF_UDT_MOD_SRC_LINE the module
+        if ((record->kind != LF_UDT_SRC_LINE && record->kind != LF_UDT_MOD_SRC_LINE) || record->size < 12)
+        {
+            continue;
+        }
+        uint32_t type_index = Load32(record->data);
+        uint32_t source = Load32(record->data + 4);
+        if (type_index < tpi.begin || type_index >= tpi.end)
+        {
+            continue;
+        }
+        const char* file = nullptr;
+        if (record->kind == LF_UDT_MOD_SRC_LINE)
+        {
+            // offset into /names
+            file = FindString(source);
+        }
+        else
+        {
+            // id of an LF_STRING_ID record: substring list id, then the string
+            auto string_id = FindIdRecord(source);
+            if (string_id && string_id->kind == LF_STRING_ID && string_id->size > 4 && memchr(string_id->data + 4, 0, string_id->size - 4))
+            {
+                file = (const char*)string_id->data + 4;
+            }
+        }
+        if (file)
+        {
+            type_sources[type_index - tpi.begin] = { file, Load32(record->data + 8) };
+        }
+    }
+}
+
+std::optional<PdbFile::SourceLine> PdbFile::FindTypeSource(uint32_t type_index)
+{
+    LoadTypeSources();
+    if (type_index < tpi.begin || type_index >= tpi.end || !type_sources[type_index - tpi.begin].file)
+    {
+        return {};
+    }
+    return type_sources[type_index - tpi.begin];
+}
+
+void PdbFile::LoadModules()
+{
+    if (modules_loaded)
+    {
+        return;
+    }
+    modules_loaded = true;
+    auto data = StreamData(dbi_stream);
+    uint32_t size = StreamSize(dbi_stream);
+    if (!data || size < dbi_header_size)
+    {
+        return;
+    }
+    uint32_t module_info_bytes = Load32(data + 24);
+    uint32_t contribution_bytes = Load32(data + 28);
+    machine = Load16(data + 58);
+    if ((uint64_t)dbi_header_size + module_info_bytes + contribution_bytes > size)
+    {
+        return;
+    }
+
+    // module infos, each padded to 4 bytes
+    auto modules = data + dbi_header_size;
+    uint32_t pos = 0;
+    while (pos + module_info_size < module_info_bytes)
+    {
+        module_streams.push_back({ Load16(modules + pos + 34), Load32(modules + pos + 36) });
+        uint32_t names = pos + module_info_size;
+        auto module_name_end = (const uint8_t*)memchr(modules + names, 0, module_info_bytes - names);
+        if (!module_name_end)
+        {
+            break;
+        }
+        names = (uint32_t)(module_name_end + 1 - modules);
+        auto object_name_end = (const uint8_t*)memchr(modules + names, 0, module_info_bytes - names);
+        if (!object_name_end)
+        {
+            break;
+        }
+        pos = ((uint32_t)(object_name_end + 1 - modules) + 3) & ~3u;
+    }
+
+    // section contributions tell which module a piece of code came from
+    auto contributions = modules + module_info_bytes;
+    if (contribution_bytes < 4)
+    {
+        return;
+    }
+    uint32_t version = Load32(contributions);
+    uint32_t entry_size = version == section_contribution_v2 ? 32 : version == section_contribution_v60 ? 28 : 0;
+    if (!entry_size)
+    {
+        return;
+    }
+    for (pos = 4; pos + entry_size <= contribution_bytes; pos += entry_size)
+    {
+        auto entry = contributions + pos;
+        section_contributions.push_back({ Load16(entry), Load32(entry + 4), Load32(entry + 8), Load16(entry + 16) });
+    }
+    std::sort(section_contributions.begin(), section_contributions.end(), [](const SectionContribution& a, const SectionContribution& b) {
+        return a.section < b.section || (a.section == b.section && a.offset < b.offset);
+        });
+}
+
+const std::vector<PdbFile::FunctionLocals>& PdbFile::LoadModuleLocals(uint16_t module)
+{
+    auto cached = module_locals.find(module);
+    if (cached != module_locals.end())
+    {
+        return cached->second;
+    }
+    auto& functions = module_locals[module];
+    if (module >= module_streams.size() || module_streams[module].first == nil_stream_index)
+    {
+        return functions;
+    }
+    auto data = StreamData(module_streams[module].first);
+    uint32_t size = std::min(StreamSize(module_streams[module].first), module_streams[module].second);
+    if (!data)
+    {
+        return functions;
+    }
+
+    // records of the frame base registers are only known after S_FRAMEPROC, resolve them when the function ends.
+    // Encoding 0 means the function has no such base pointer.
+    auto frame_register = [&](uint32_t encoded) -> uint16_t {
+        if (encoded == 0)
+        {
+            return CV_REG_NONE;
+        }
+        if (machine == image_file_machine_amd64)
+        {
+            return encoded == 1 ? CV_AMD64_RSP : encoded == 3 ? CV_AMD64_R13 : CV_AMD64_RBP;
+        }
+        return encoded == 1 ? CV_ALLREG_VFRAME : encoded == 3 ? CV_REG_EBX : CV_REG_EBP;
+    };
+    const uint16_t frame_pointer_placeholder = 0xffff;
+
+    FunctionLocals* function = nullptr;
+    uint32_t frame_flags = 0;
+    // address range of every open scope, one entry per record closed by S_END, S_PROC_ID_END or S_INLINESITE_END.
+    // Scopes other than procedures and blocks inherit the range of the enclosing one.
+    std::vector<std::pair<uint32_t, uint32_t>> blocks;
+    auto enclosing = [&]() {
+        return blocks.empty() ? std::pair<uint32_t, uint32_t>(0, 0) : blocks.back();
+    };
+    uint32_t inline_depth = 0;
+    LocalVariable current = {};
+    bool has_current = false;
+
+    auto add = [&](uint32_t start, uint32_t end, const LocalVariable& variable) {
+        if (function && start < end)
+        {
+            function->locals.push_back({ start, end, variable });
+        }
+    };
+    // live range of a S_DEFRANGE_* record minus its gaps
+    auto add_range = [&](const uint8_t* range, const uint8_t* gaps, const uint8_t* record_end, const LocalVariable& variable) {
+        const uint32_t range_start = Load32(range);
+        const uint32_t end = range_start + Load16(range + 6);
+        uint32_t start = range_start;
+        for (auto gap = gaps; gap + 4 <= record_end; gap += 4)
+        {
+            // gap offsets are relative to the start of the range, not to the end of the previous gap
+            uint32_t gap_start = std::min(range_start + Load16(gap), end);
+            uint32_t gap_end = std::min(gap_start + Load16(gap + 2), end);
+            add(start, gap_start, variable);
+            start = std::max(start, gap_end);
+        }
+        add(start, end, variable);
+    };
+    auto finish_function = [&]() {
+        if (!function)
+        {
+            return;
+        }
+        for (auto& local : function->locals)
+        {
+            if (local.variable.register_id == frame_pointer_placeholder)
+            {
+                // locals use the local base pointer (bits 14-15), parameters the parameter base pointer (bits 16-17)
+                local.variable.register_id = frame_register(local.variable.is_parameter ? (frame_flags >> 16) & 3 : (frame_flags >> 14) & 3);
+            }
+        }
+        // frame relative locals of a function without the base pointer (or without S_FRAMEPROC) have no known location
+        function->locals.erase(std::remove_if(function->locals.begin(), function->locals.end(), [](const LiveLocal& local) {
+            return local.variable.register_relative && local.variable.register_id == CV_REG_NONE;
+            }), function->locals.end());
+        std::sort(function->locals.begin(), function->locals.end(), [](const LiveLocal& a, const LiveLocal& b) { return a.start < b.start; });
+        function = nullptr;
+    };
+
+    // the stream starts with a 4 byte signature
+    for (uint32_t pos = 4; pos + 4 <= size; )
+    {
+        uint16_t length = Load16(data + pos);
+        if (length < 2 || pos + 2 + length > size)
+        {
+            break;
+        }
+        uint16_t kind = Load16(data + pos + 2);
+        auto record = data + pos + 4;
+        auto record_end = data + pos + 2 + length;
+        uint32_t record_size = length - 2;
+        pos += 2 + length;
+
+        switch (kind)
+        {
+        case S_GPROC32:
+        case S_LPROC32:
+        case S_GPROC32_ID:
+        case S_LPROC32_ID:
+            if (record_size >= 35 && blocks.empty())
+            {
+                finish_function();
+                functions.push_back({ Load16(record + 32), Load32(record + 28), Load32(record + 12), {} });
+                function = &functions.back();
+                frame_flags = 0;
+                blocks.push_back({ function->offset, function->offset + function->length });
+            }
+            else
+            {
+                blocks.push_back(enclosing());
+            }
+            has_current = false;
+            continue;
+        case S_BLOCK32:
+            if (record_size >= 18)
+            {
+                blocks.push_back({ Load32(record + 12), Load32(record + 12) + Load32(record + 8) });
+            }
+            else
+            {
+                blocks.push_back(enclosing());
+            }
+            continue;
+        case S_THUNK32:
+        case S_WITH32:
+        case S_SEPCODE:
+            blocks.push_back(enclosing());
+            continue;
+        case S_INLINESITE:
+        case S_INLINESITE2:
+            inline_depth++;
+            blocks.push_back(enclosing());
+            continue;
+        case S_INLINESITE_END:
+            inline_depth -= inline_depth ? 1 : 0;
+            if (!blocks.empty())
+            {
+                blocks.pop_back();
+            }
+            has_current = false;
+            continue;
+        case S_END:
+        case S_PROC_ID_END:
+            if (!blocks.empty())
+            {
+                blocks.pop_back();
+            }
+            if (blocks.empty())
+            {
+                finish_function();
+            }
+            has_current = false;
+            continue;
+        case S_FRAMEPROC:
+            if (record_size >= 26)
+            {
+                frame_flags = Load32(record + 22);
+            }
+            continue;
+        default:
+            break;
+        }
+        // locals of inlined functions belong to the inlinee
+        if (!function || inline_depth)
+        {
+            continue;
+        }
+
+        auto& scope = blocks.back();
+        auto name_at = [&](uint32_t offset) -> const char* {
+            if (offset >= record_size || !memchr(record + offset, 0, record_size - offset))
+            {
+                return nullptr;
+            }
+            return (const char*)record + offset;
+        };
+        switch (kind)
+        {
+        case S_LOCAL:
+        {
+            auto name = name_at(6);
+            has_current = name != nullptr;
+            if (has_current)
+            {
+                current = { name, Load32(record), (Load16(record + 4) & 1) != 0, 0, false, 0 };
+            }
+            break;
+        }
+        case S_DEFRANGE_REGISTER:
+            if (has_current && record_size >= 12)
+            {
+                auto variable = current;
+                variable.register_id = Load16(record);
+                add_range(record + 4, record + 12, record_end, variable);
+            }
+            break;
+        case S_DEFRANGE_FRAMEPOINTER_REL:
+            if (has_current && record_size >= 12)
+            {
+                auto variable = current;
+                variable.register_id = frame_pointer_placeholder;
+                variable.register_relative = true;
+                variable.offset = (int32_t)Load32(record);
+                add_range(record + 4, record + 12, record_end, variable);
+            }
+            break;
+        case S_DEFRANGE_FRAMEPOINTER_REL_FULL_SCOPE:
+            if (has_current && record_size >= 4)
+            {
+                auto variable = current;
+                variable.register_id = frame_pointer_placeholder;
+                variable.register_relative = true;
+                variable.offset = (int32_t)Load32(record);
+                add(scope.first, scope.second, variable);
+            }
+            break;
+        case S_DEFRANGE_REGISTER_REL:
+            if (has_current && record_size >= 16)
+            {
+                auto variable = current;
+                variable.register_id = Load16(record);
+                variable.register_relative = true;
+                variable.offset = (int32_t)Load32(record + 4);
+                add_range(record + 8, record + 16, record_end, variable);
+            }
+            break;
+        case S_REGREL32:
+        {
+            auto name = name_at(10);
+            if (name)
+            {
+                add(scope.first, scope.second, { name, Load32(record + 4), false, Load16(record + 8), true, (int32_t)Load32(record) });
+            }
+            has_current = false;
+            break;
+        }
+        case S_BPREL32:
+        {
+            auto name = name_at(8);
+            if (name)
+            {
+                add(scope.first, scope.second, { name, Load32(record + 4), false, frame_pointer_placeholder, true, (int32_t)Load32(record) });
+            }
+            has_current = false;
+            break;
+        }
+        case S_REGISTER:
+        {
+            auto name = name_at(6);
+            if (name)
+            {
+                add(scope.first, scope.second, { name, Load32(record), false, Load16(record + 4), false, 0 });
+            }
+            has_current = false;
+            break;
+        }
+        default:
+            // other S_DEFRANGE_* kinds (subfields, MSIL) keep the current local, anything else ends it
+            if (kind < 0x113f || kind > 0x1145)
+            {
+                has_current = false;
+            }
+            break;
+        }
+    }
+    finish_function();
+    std::sort(functions.begin(), functions.end(), [](const FunctionLocals& a, const FunctionLocals& b) {
+        return a.section < b.section || (a.section == b.section && a.offset < b.offset);
+        });
+    return functions;
+}
+
+std::vector<PdbFile::LocalVariable> PdbFile::FindLocals(uint16_t section, uint32_t offset)
+{
+    LoadModules();
+    // the contribution covering the address names the module
+    auto contribution = std::upper_bound(section_contributions.begin(), section_contributions.end(), std::make_pair(section, offset),
+        [](const std::pair<uint16_t, uint32_t>& address, const SectionContribution& c) {
+            return address.first < c.section || (address.first == c.section && address.second < c.offset);
+        });
+    if (contribution == section_contributions.begin())
+    {
+        return {};
+    }
+    --contribution;
+    if (contribution->section != section || offset - contribution->offset >= contribution->size)
+    {
+        return {};
+    }
+
+    auto& functions = LoadModuleLocals(contribution->module);
+    auto function = std::upper_bound(functions.begin(), functions.end(), std::make_pair(section, offset),
+        [](const std::pair<uint16_t, uint32_t>& address, const FunctionLocals& f) {
+            return address.first < f.section || (address.first == f.section && address.second < f.offset);
+        });
+    if (function == functions.begin())
+    {
+        return {};
+    }
+    --function;
+    if (function->section != section || offset - function->offset >= function->length)
+    {
+        return {};
+    }
+    std::vector<LocalVariable> ret;
+    for (auto& local : function->locals)
+    {
+        if (local.start > offset)
+        {
+            break;
+        }
+        if (offset < local.end)
+        {
+            ret.push_back(local.variable);
+        }
+    }
+    return ret;
+}
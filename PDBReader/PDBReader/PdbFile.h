@@ -0,0 +1,205 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <optional>
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+// Direct reader for the parts of a pdb which DIA doesn't expose: the /names string table, the raw TPI and IPI
+// (type and id) records, the source locations of type definitions and the live ranges of locals.
+// The file is mapped read only and streams are used in place when their blocks are contiguous.
+class PdbFile
+{
+public:
+    class Record
+    {
+    public:
+        // LF_* leaf kind
+        uint16_t kind;
+        // record contents after the kind
+        const uint8_t* data;
+        uint16_t size;
+    };
+
+    class SourceLine
+    {
+    public:
+        // points into the pdb's string data, valid as long as the PdbFile
+        const char* file;
+        uint32_t line;
+    };
+
+    class LocalVariable
+    {
+    public:
+        // points into the module's symbols, valid as long as the PdbFile
+        const char* name;
+        // TPI type index
+        uint32_t type_index;
+        bool is_parameter;
+        // CV_HREG_e of the register holding the value, or of the base register for register_relative
+        uint16_t register_id;
+        // the value is at [register + offset] rather than in the register
+        bool register_relative;
+        int32_t offset;
+    };
+
+    static constexpr uint16_t LF_FUNC_ID = 0x1601;
+    static constexpr uint16_t LF_MFUNC_ID = 0x1602;
+    static constexpr uint16_t LF_BUILDINFO = 0x1603;
+    static constexpr uint16_t LF_SUBSTR_LIST = 0x1604;
+    static constexpr uint16_t LF_STRING_ID = 0x1605;
+    static constexpr uint16_t LF_UDT_SRC_LINE = 0x1606;
+    static constexpr uint16_t LF_UDT_MOD_SRC_LINE = 0x1607;
+    static constexpr uint16_t LF_CLASS = 0x1504;
+    static constexpr uint16_t LF_STRUCTURE = 0x1505;
+    static constexpr uint16_t LF_UNION = 0x1506;
+    static constexpr uint16_t LF_ENUM = 0x1507;
+    static constexpr uint16_t LF_INTERFACE = 0x1519;
+
+    // Maps pdb_file read only, throws if it isn't an msf 7.0 file.
+    PdbFile(std::wstring pdb_file);
+
+    ~PdbFile();
+
+    PdbFile(const PdbFile&) = delete;
+    PdbFile& operator=(const PdbFile&) = delete;
+
+    uint32_t StreamCount() const;
+
+    uint32_t StreamSize(uint32_t stream) const;
+
+    // Contents of a stream, StreamSize() bytes. Points into the mapping if the stream's blocks are contiguous,
+    // otherwise the stream is assembled once and kept. nullptr if the stream doesn't exist.
+    const uint8_t* StreamData(uint32_t stream);
+
+    // Streams listed in the pdb info stream by name, like "/names" or "/LinkInfo".
+    std::optional<uint32_t> FindNamedStream(const std::string& name);
+
+    // String at an offset into /names, the form records refer to strings in. nullptr if out of range.
+    const char* FindString(uint32_t offset);
+
+    // Offset of a string in /names through the table's hash buckets.
+    std::optional<uint32_t> FindStringOffset(const std::string& str);
+
+    // Type indexes of the TPI stream are [TypeBegin(), TypeEnd()).
+    uint32_t TypeBegin();
+
+    uint32_t TypeEnd();
+
+    // TPI record of a type index, one array read.
+    std::optional<Record> FindTypeRecord(uint32_t type_index);
+
+    // Type indexes of the IPI stream are [IdBegin(), IdEnd()).
+    uint32_t IdBegin();
+
+    uint32_t IdEnd();
+
+    // IPI record of a type index, one array read.
+    std::optional<Record> FindIdRecord(uint32_t type_index);
+
+    // Name of a class, structure, union, interface or enum record, nullptr for other records.
+    const char* FindUDTName(uint32_t type_index);
+
+    // TPI type index of the definition (not a forward reference) of a class, structure, union, interface or enum.
+    std::optional<uint32_t> FindUDTTypeIndex(const std::string& name);
+
+    // Where a type was defined, from the LF_UDT_SRC_LINE / LF_UDT_MOD_SRC_LINE records of the IPI stream.
+    std::optional<SourceLine> FindTypeSource(uint32_t type_index);
+
+    // Locals and parameters live at section:offset, with their location there. Symbols are read per module,
+    // the first time one of its functions is asked for.
+    std::vector<LocalVariable> FindLocals(uint16_t section, uint32_t offset);
+
+private:
+    class LiveLocal
+    {
+    public:
+        // section offsets, [start, end)
+        uint32_t start;
+        uint32_t end;
+        LocalVariable variable;
+    };
+
+    class FunctionLocals
+    {
+    public:
+        uint16_t section;
+        uint32_t offset;
+        uint32_t length;
+        // sorted by start
+        std::vector<LiveLocal> locals;
+    };
+
+    class SectionContribution
+    {
+    public:
+        uint16_t section;
+        uint32_t offset;
+        uint32_t size;
+        uint16_t module;
+    };
+
+    class TypeStream
+    {
+    public:
+        bool loaded = false;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        const uint8_t* records = nullptr;
+        // offset of every record in records, indexed by type index - begin
+        std::vector<uint32_t> offsets;
+    };
+
+    void LoadNames();
+
+    void LoadTypeStream(uint32_t stream, TypeStream& out);
+
+    std::optional<Record> FindRecord(TypeStream& types, uint32_t type_index);
+
+    void LoadTypeSources();
+
+    void LoadModules();
+
+    // functions of a module sorted by address, parsed from its symbol stream
+    const std::vector<FunctionLocals>& LoadModuleLocals(uint16_t module);
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const uint8_t* base = nullptr;
+    uint64_t file_size = 0;
+
+    uint32_t block_size = 0;
+    std::vector<uint32_t> stream_sizes;
+    std::vector<std::vector<uint32_t>> stream_blocks;
+    // streams whose blocks aren't contiguous, assembled on first use
+    std::map<uint32_t, std::vector<uint8_t>> assembled_streams;
+
+    bool names_loaded = false;
+    uint32_t names_hash_version = 0;
+    const char* names_strings = nullptr;
+    uint32_t names_strings_size = 0;
+    const uint8_t* names_buckets = nullptr;
+    uint32_t names_bucket_count = 0;
+
+    TypeStream tpi;
+    TypeStream ipi;
+
+    // UDT name -> TPI type index of its definition
+    std::unordered_map<std::string, uint32_t> udt_type_indexes;
+    bool udt_type_indexes_built = false;
+
+    // indexed by TPI type index - TypeBegin(), file is nullptr for types without a source location
+    std::vector<SourceLine> type_sources;
+    bool type_sources_loaded = false;
+
+    bool modules_loaded = false;
+    uint16_t machine = 0;
+    // symbol stream and symbol bytes of every module
+    std::vector<std::pair<uint16_t, uint32_t>> module_streams;
+    // sorted by (section, offset)
+    std::vector<SectionContribution> section_contributions;
+    std::map<uint16_t, std::vector<FunctionLocals>> module_locals;
+};
@@ -0,0 +1,279 @@
+#include "X64Unwinder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    enum UnwindOp
+    {
+        UWOP_PUSH_NONVOL = 0,
+        UWOP_ALLOC_LARGE = 1,
+        UWOP_ALLOC_SMALL = 2,
+        UWOP_SET_FPREG = 3,
+        UWOP_SAVE_NONVOL = 4,
+        UWOP_SAVE_NONVOL_FAR = 5,
+        UWOP_EPILOG = 6,
+        UWOP_SPARE_CODE = 7,
+        UWOP_SAVE_XMM128 = 8,
+        UWOP_SAVE_XMM128_FAR = 9,
+        UWOP_PUSH_MACHFRAME = 10,
+    };
+
+    constexpr uint8_t UNW_FLAG_CHAININFO = 0x4;
+    constexpr int rsp_index = 4;
+    // chains longer than this are treated as broken
+    constexpr int max_chain_depth = 32;
+
+    // slots of 2 bytes an unwind code takes, including its own
+    uint32_t SlotCount(uint8_t op, uint8_t info)
+    {
+        switch (op)
+        {
+        case UWOP_ALLOC_LARGE:
+            return info ? 3 : 2;
+        case UWOP_SAVE_NONVOL:
+        case UWOP_SAVE_XMM128:
+        case UWOP_EPILOG:
+            return 2;
+        case UWOP_SAVE_NONVOL_FAR:
+        case UWOP_SAVE_XMM128_FAR:
+        case UWOP_SPARE_CODE:
+            return 3;
+        default:
+            return 1;
+        }
+    }
+
+    uint32_t Load16(const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    uint32_t Load32(const uint8_t* p)
+    {
+        return Load16(p) | (Load16(p + 2) << 16);
+    }
+}
+
+X64Unwinder::X64Unwinder(std::vector<RuntimeFunction> functions, std::vector<uint8_t> xdata, uint32_t xdata_rva)
+    : functions(std::move(functions)), xdata(std::move(xdata)), xdata_rva(xdata_rva)
+{
+    std::sort(this->functions.begin(), this->functions.end(), [](const RuntimeFunction& a, const RuntimeFunction& b) {
+        return a.begin < b.begin;
+        });
+    begins.reserve(this->functions.size());
+    for (auto& function : this->functions)
+    {
+        begins.push_back(function.begin);
+    }
+}
+
+const X64Unwinder::RuntimeFunction* X64Unwinder::FindFunction(uint32_t rva) const
+{
+    auto it = std::upper_bound(begins.begin(), begins.end(), rva);
+    if (it == begins.begin())
+    {
+        return nullptr;
+    }
+    auto& function = functions[it - begins.begin() - 1];
+    return rva < function.end ? &function : nullptr;
+}
+
+const uint8_t* X64Unwinder::UnwindData(uint32_t rva, uint32_t size) const
+{
+    if (rva < xdata_rva || (uint64_t)rva - xdata_rva + size > xdata.size())
+    {
+        return nullptr;
+    }
+    return xdata.data() + (rva - xdata_rva);
+}
+
+bool X64Unwinder::UnwindFrame(Context& context, uint64_t image_base, uint64_t stack_address, const uint8_t* stack, size_t stack_size,
+    bool* return_address) const
+{
+    auto read = [&](uint64_t address, uint64_t& value)
+    {
+        if (address < stack_address || address - stack_address + 8 > stack_size)
+        {
+            return false;
+        }
+        memcpy(&value, stack + (address - stack_address), 8);
+        return true;
+    };
+    auto& rsp = context.regs[rsp_index];
+    bool machine_frame = false;
+
+    uint32_t rva = (uint32_t)(context.rip - image_base);
+    auto function = FindFunction(rva);
+    // without an entry the function is a leaf, which doesn't touch rsp
+    if (function)
+    {
+        uint32_t prolog_offset = rva - function->begin;
+        uint32_t info_rva = function->unwind_info;
+        bool primary = true;
+        for (int depth = 0; ; depth++)
+        {
+            auto info = UnwindData(info_rva, 4);
+            if (depth == max_chain_depth || !info)
+            {
+                return false;
+            }
+            uint8_t flags = info[0] >> 3;
+            uint8_t prolog_size = info[1];
+            uint32_t code_count = info[2];
+            uint8_t frame_register = info[3] & 0xf;
+            uint32_t frame_offset = info[3] >> 4;
+            auto codes = UnwindData(info_rva + 4, code_count * 2);
+            if (!codes)
+            {
+                return false;
+            }
+            // inside the prolog only the instructions executed so far are undone, chained infos always apply
+            auto executed = [&](const uint8_t* code) {
+                return !primary || prolog_offset >= prolog_size || code[0] <= prolog_offset;
+            };
+
+            // saves are addressed from the frame base: the frame register once it is set up, rsp after the prolog otherwise.
+            // It has to be taken before any code is undone, as undoing allocations and pushes moves rsp.
+            uint64_t frame_base = rsp;
+            if (frame_register)
+            {
+                for (uint32_t i = 0; i < code_count; i += SlotCount(codes[i * 2 + 1] & 0xf, codes[i * 2 + 1] >> 4))
+                {
+                    if ((codes[i * 2 + 1] & 0xf) == UWOP_SET_FPREG && executed(codes + i * 2))
+                    {
+                        frame_base = context.regs[frame_register] - frame_offset * 16;
+                        break;
+                    }
+                }
+            }
+
+            for (uint32_t i = 0; i < code_count; )
+            {
+                auto code = codes + i * 2;
+                uint8_t op = code[1] & 0xf;
+                uint8_t op_info = code[1] >> 4;
+                uint32_t slots = SlotCount(op, op_info);
+                if (i + slots > code_count)
+                {
+                    return false;
+                }
+                i += slots;
+                if (!executed(code))
+                {
+                    continue;
+                }
+                uint64_t value;
+                switch (op)
+                {
+                case UWOP_PUSH_NONVOL:
+                    if (!read(rsp, value))
+                    {
+                        return false;
+                    }
+                    context.regs[op_info] = value;
+                    rsp += 8;
+                    break;
+                case UWOP_ALLOC_LARGE:
+                    rsp += op_info ? Load32(code + 2) : Load16(code + 2) * 8;
+                    break;
+                case UWOP_ALLOC_SMALL:
+                    rsp += op_info * 8 + 8;
+                    break;
+                case UWOP_SET_FPREG:
+                    rsp = context.regs[frame_register] - frame_offset * 16;
+                    break;
+                case UWOP_SAVE_NONVOL:
+                case UWOP_SAVE_NONVOL_FAR:
+                    if (!read(frame_base + (op == UWOP_SAVE_NONVOL ? Load16(code + 2) * 8 : Load32(code + 2)), value))
+                    {
+                        return false;
+                    }
+                    context.regs[op_info] = value;
+                    break;
+                case UWOP_PUSH_MACHFRAME:
+                {
+                    // interrupt or exception frame: optional error code, then rip, cs, eflags, rsp, ss
+                    uint64_t frame = rsp + (op_info ? 8 : 0);
+                    uint64_t old_rsp;
+                    if (!read(frame, value) || !read(frame + 24, old_rsp))
+                    {
+                        return false;
+                    }
+                    context.rip = value;
+                    rsp = old_rsp;
+                    machine_frame = true;
+                    break;
+                }
+                default:
+                    // xmm registers aren't tracked, epilog descriptions are only needed inside epilogs
+                    break;
+                }
+            }
+
+            if (!(flags & UNW_FLAG_CHAININFO))
+            {
+                break;
+            }
+            // the chained RUNTIME_FUNCTION follows the codes, which are padded to an even count
+            auto chained = UnwindData(info_rva + 4 + ((code_count + 1) & ~1u) * 2, 12);
+            if (!chained)
+            {
+                return false;
+            }
+            info_rva = Load32(chained + 8);
+            primary = false;
+        }
+    }
+
+    if (!machine_frame)
+    {
+        uint64_t caller;
+        if (!read(rsp, caller))
+        {
+            return false;
+        }
+        context.rip = caller;
+        rsp += 8;
+    }
+    if (return_address)
+    {
+        *return_address = !machine_frame;
+    }
+    return true;
+}
+
+std::vector<X64Unwinder::Frame> X64Unwinder::Walk(const std::vector<Module>& modules, Context context, uint64_t stack_address,
+    const uint8_t* stack, size_t stack_size, size_t max_frames)
+{
+    std::vector<Frame> frames;
+    bool return_address = false;
+    while (frames.size() < max_frames)
+    {
+        auto module = std::find_if(modules.begin(), modules.end(), [&](const Module& m) {
+            return context.rip >= m.base && context.rip - m.base < m.size;
+            });
+        if (module == modules.end())
+        {
+            break;
+        }
+        Frame frame = {};
+        frame.rip = context.rip;
+        frame.rsp = context.regs[rsp_index];
+        frame.module = module - modules.begin();
+        frame.rva = (uint32_t)(context.rip - module->base);
+        frame.lookup_rva = frame.rva - (return_address && frame.rva ? 1 : 0);
+        frames.push_back(frame);
+
+        if (!module->unwinder->UnwindFrame(context, module->base, stack_address, stack, stack_size, &return_address))
+        {
+            break;
+        }
+        // every caller frame lies above its callee, anything else is a corrupted stack
+        if (context.regs[rsp_index] <= frame.rsp || !context.rip)
+        {
+            break;
+        }
+    }
+    return frames;
+}
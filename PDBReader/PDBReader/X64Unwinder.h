@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Unwinds captured x64 stacks with the unwind data of the images (.pdata and .xdata). Doesn't use DIA or any
+// Windows API, so stacks can be unwound on any host. PDBReader::CreateX64Unwinder() fills one from the copies
+// of .pdata and .xdata kept in the pdb, or it can be built from the sections of the image itself.
+class X64Unwinder
+{
+public:
+    class RuntimeFunction
+    {
+    public:
+        uint32_t begin;
+        uint32_t end;
+        uint32_t unwind_info;
+    };
+
+    // registers in the numbering of the unwind codes: rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8 - r15
+    class Context
+    {
+    public:
+        uint64_t rip;
+        uint64_t regs[16];
+    };
+
+    class Frame
+    {
+    public:
+        uint64_t rip;
+        uint64_t rsp;
+        // index into the modules passed to Walk()
+        size_t module;
+        // rip relative to the module
+        uint32_t rva;
+        // rva to look the function up with: rva itself for the first frame and interrupted frames, one byte before
+        // it for return addresses, which lie past the end of a function whose last instruction is the call
+        uint32_t lookup_rva;
+    };
+
+    class Module
+    {
+    public:
+        uint64_t base;
+        uint64_t size;
+        const X64Unwinder* unwinder;
+    };
+
+    // xdata holds the image bytes starting at xdata_rva, all unwind infos referenced by functions must lie inside.
+    X64Unwinder(std::vector<RuntimeFunction> functions, std::vector<uint8_t> xdata, uint32_t xdata_rva);
+
+    const RuntimeFunction* FindFunction(uint32_t rva) const;
+
+    // Unwinds context by one frame of this image, stack holds the captured bytes starting at stack_address.
+    // Returns false if the frame needs stack bytes that weren't captured, or the unwind data is broken.
+    // return_address receives whether the new rip was popped as a return address rather than restored from a machine frame.
+    bool UnwindFrame(Context& context, uint64_t image_base, uint64_t stack_address, const uint8_t* stack, size_t stack_size,
+        bool* return_address = nullptr) const;
+
+    // Walks a captured stack starting at context. The walk ends at a return address outside of modules,
+    // at a frame that doesn't move rsp up, when the captured stack runs out, or after max_frames.
+    static std::vector<Frame> Walk(const std::vector<Module>& modules, Context context, uint64_t stack_address,
+        const uint8_t* stack, size_t stack_size, size_t max_frames = 256);
+
+private:
+    const uint8_t* UnwindData(uint32_t rva, uint32_t size) const;
+
+    // begin of every function, searched instead of functions to touch fewer cache lines
+    std::vector<uint32_t> begins;
+    std::vector<RuntimeFunction> functions;
+    std::vector<uint8_t> xdata;
+    uint32_t xdata_rva;
+};
@@ -0,0 +1,178 @@
+#include "benchmark.h"
+#include "PDBReader/pdbreader.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    struct Fixture
+    {
+        std::wstring label;
+        std::wstring pdb;
+        std::wstring symbol;
+        std::wstring struct_name;
+        std::wstring member_name;
+        DWORD rva;
+    };
+
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations;
+        double ns_per_iteration;
+    };
+
+    // minimum accumulated run time of one benchmark, same idea as --benchmark_min_time
+    constexpr auto min_run_time = std::chrono::milliseconds(500);
+    constexpr uint64_t max_iterations = 1000000000;
+
+    std::string narrow(const std::wstring& in)
+    {
+        return std::string(in.begin(), in.end());
+    }
+
+    std::vector<std::wstring> split(const std::wstring& line, wchar_t sep)
+    {
+        std::vector<std::wstring> ret;
+        std::wstringstream ss(line);
+        std::wstring item;
+        while (std::getline(ss, item, sep))
+        {
+            ret.push_back(item);
+        }
+        return ret;
+    }
+
+    std::vector<Fixture> LoadFixtures(const std::wstring& fixture_list)
+    {
+        std::wifstream in(fixture_list);
+        if (!in.is_open())
+        {
+            throw std::exception("cannot open fixture list");
+        }
+        std::vector<Fixture> ret;
+        std::wstring line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == L'\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == L'#')
+            {
+                continue;
+            }
+            auto fields = split(line, L'\t');
+            if (fields.size() != 6)
+            {
+                throw std::exception("malformed line in fixture list");
+            }
+            ret.push_back({ fields[0], fields[1], fields[2], fields[3], fields[4], (DWORD)std::stoul(fields[5], nullptr, 0) });
+        }
+        return ret;
+    }
+
+    // doubles the iteration count until the batch runs for at least min_run_time
+    Result Measure(const std::string& name, const std::function<void()>& body)
+    {
+        uint64_t iterations = 1;
+        while (true)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++)
+            {
+                body();
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed >= min_run_time || iterations >= max_iterations)
+            {
+                double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                std::cout << name << "\t" << iterations << "\t" << ns / iterations << " ns" << std::endl;
+                return { name, iterations, ns / iterations };
+            }
+            iterations *= 2;
+        }
+    }
+
+    void RunFixture(const Fixture& f, std::vector<Result>& results)
+    {
+        auto prefix = narrow(f.label) + "/";
+        results.push_back(Measure(prefix + "Open", [&]() {
+            PDBReader reader(f.pdb);
+            }));
+
+        PDBReader reader(f.pdb);
+        DWORD type = 0;
+        auto miss = f.symbol + L"__pdbreader_bench_miss";
+        results.push_back(Measure(prefix + "FindSymbol/hit", [&]() {
+            if (!reader.FindSymbol(f.symbol, type))
+            {
+                throw std::exception("FindSymbol() hit case returned nothing");
+            }
+            }));
+        results.push_back(Measure(prefix + "FindSymbol/miss", [&]() {
+            reader.FindSymbol(miss, type);
+            }));
+        results.push_back(Measure(prefix + "FindStructMemberOffset", [&]() {
+            if (!reader.FindStructMemberOffset(f.struct_name, f.member_name))
+            {
+                throw std::exception("FindStructMemberOffset() returned nothing");
+            }
+            }));
+        results.push_back(Measure(prefix + "GetStructureFields", [&]() {
+            reader.GetStructureFields(f.struct_name);
+            }));
+        std::wstring name;
+        results.push_back(Measure(prefix + "FindMostRelatedFunctionName", [&]() {
+            reader.FindMostRelatedFunctionName(f.rva, name);
+            }));
+        results.push_back(Measure(prefix + "FindNearestSymbolFromRVA", [&]() {
+            reader.FindNearestSymbolFromRVA(f.rva, name, type);
+            }));
+        auto dump_file = std::filesystem::temp_directory_path() / L"pdbreader_bench_dump.txt";
+        results.push_back(Measure(prefix + "DumpTypes/PublicSymbol", [&]() {
+            reader.DumpTypes(SymTagEnum::SymTagPublicSymbol, dump_file.wstring());
+            }));
+        results.push_back(Measure(prefix + "DumpTypes/PublicSymbolUndecorated", [&]() {
+            reader.DumpTypes(SymTagEnum::SymTagPublicSymbol, dump_file.wstring(), true);
+            }));
+        std::filesystem::remove(dump_file);
+    }
+
+    void WriteJson(const std::wstring& out_json, const std::vector<Result>& results)
+    {
+        std::ofstream out(out_json, std::ofstream::binary);
+        if (!out.is_open())
+        {
+            throw std::exception("cannot create file for output");
+        }
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        out << "{\n  \"context\": {\n    \"date\": " << now << ",\n    \"library\": \"PDBReader\"\n  },\n";
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            auto& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"run_type\": \"iteration\", \"iterations\": " << r.iterations
+                << ", \"real_time\": " << r.ns_per_iteration << ", \"time_unit\": \"ns\"}";
+            out << (i + 1 == results.size() ? "\n" : ",\n");
+        }
+        out << "  ]\n}\n";
+    }
+}
+
+int RunBenchmarks(const std::wstring& fixture_list, const std::wstring& out_json)
+{
+    auto fixtures = LoadFixtures(fixture_list);
+    std::vector<Result> results;
+    for (auto& f : fixtures)
+    {
+        RunFixture(f, results);
+    }
+    WriteJson(out_json, results);
+    return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+// Runs the query path benchmarks against the fixture pdbs listed in fixture_list and writes
+// the results to out_json in Google Benchmark's JSON layout.
+//
+// Every non-empty line of fixture_list that does not start with '#' describes one fixture,
+// fields are separated by tabs:
+//   label  pdb_path  symbol  struct  member  rva
+// symbol should exist in the pdb (hit case), struct/member should be a valid pair and rva
+// should fall into a function.
+int RunBenchmarks(const std::wstring& fixture_list, const std::wstring& out_json);
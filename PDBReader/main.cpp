@@ -1,11 +1,76 @@
 #include "PDBReader/pdbreader.h"
+#include "benchmark.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
-int main() 
+int wmain(int argc, wchar_t* argv[])
 {
     try
     {
         PDBReader::CoInit();
+        // usage: PDBReader.exe bench <fixture list> <output json>
+        if (argc == 4 && std::wstring(argv[1]) == L"bench")
+        {
+            return RunBenchmarks(argv[2], argv[3]);
+        }
+        // usage: PDBReader.exe codegen <pdb> <file with one structure name per line> <output header>
+        if (argc == 5 && std::wstring(argv[1]) == L"codegen")
+        {
+            std::wifstream in(argv[3]);
+            std::vector<std::wstring> structs;
+            std::wstring line;
+            while (std::getline(in, line))
+            {
+                if (!line.empty())
+                {
+                    structs.push_back(line);
+                }
+            }
+            PDBReader reader(argv[2]);
+            reader.GenerateOffsetHeader(structs, argv[4]);
+            return 0;
+        }
+        // usage: PDBReader.exe offsetdb <file with one pdb path per line> <query file> <output database>
+        // every query line is one of "offset <struct> <member>", "size <struct>" or "rva <symbol>"
+        if (argc == 5 && std::wstring(argv[1]) == L"offsetdb")
+        {
+            std::wifstream pdb_list(argv[2]);
+            std::vector<std::wstring> pdbs;
+            std::wstring line;
+            while (std::getline(pdb_list, line))
+            {
+                if (!line.empty())
+                {
+                    pdbs.push_back(line);
+                }
+            }
+            std::wifstream query_list(argv[3]);
+            std::vector<OffsetDatabase::Query> queries;
+            while (std::getline(query_list, line))
+            {
+                std::wstringstream ss(line);
+                std::wstring kind, name, member;
+                ss >> kind >> name >> member;
+                if (kind == L"offset")
+                {
+                    queries.push_back({ OffsetDatabase::Query::Kind::StructMemberOffset, name, member });
+                }
+                else if (kind == L"size")
+                {
+                    queries.push_back({ OffsetDatabase::Query::Kind::StructSize, name, L"" });
+                }
+                else if (kind == L"rva")
+                {
+                    queries.push_back({ OffsetDatabase::Query::Kind::SymbolRVA, name, L"" });
+                }
+            }
+            for (auto& failed : PDBReader::BuildOffsetDatabase(pdbs, queries, argv[4]))
+            {
+                std::wcout << L"Failed to load " << failed << std::endl;
+            }
+            return 0;
+        }
         //std::cout << "Start downloading symbol files\n";
         //PDBReader::DownloadPDBForFile(L"C:\\windows\\system32\\ntoskrnl.exe", L"Symbols");
         //std::cout << "Download pdb succeed." << std::endl;